@@ -0,0 +1,337 @@
+#include "async_log.hpp"
+
+#if COMPILE_ASYNCLOG == 1
+
+#include "byte_ring.hpp"
+
+#include <signal.h>
+#include <sys/syscall.h>
+
+// Records are a 4 byte header (length << 1 | colored) followed by the text. Producers are
+// serialized by the stdout lock, so the ring only has one writer and one reader at a time.
+#define ASYNC_LOG_HEADER 4
+
+static char async_log_buffer[ASYNC_LOG_RING_SIZE];
+static byteRing_t async_log_ring = BYTE_RING_INIT(async_log_buffer);
+static unsigned int async_log_lost = 0;
+static bool async_log_started = false;
+static int async_log_direct = 0; // set once the process is going down, text is written right away
+static pid_t async_log_pid = 0;
+
+static const int async_log_fatal_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+static struct sigaction async_log_previous[sizeof(async_log_fatal_signals) / sizeof(async_log_fatal_signals[0])];
+
+// Same translation Sys_AnsiColorPrint does without stdio, it also runs in signal handlers.
+// out has room for length * 5 + 4 bytes
+static int async_log_translate(const char *msg, int length, char *out)
+{
+	static int q3ToAnsi[ 8 ] =
+	{
+		30, // COLOR_BLACK
+		31, // COLOR_RED
+		32, // COLOR_GREEN
+		33, // COLOR_YELLOW
+		34, // COLOR_BLUE
+		36, // COLOR_CYAN
+		35, // COLOR_MAGENTA
+		0   // COLOR_WHITE
+	};
+
+	int written = 0;
+	bool text = false;
+
+	for (int i = 0; i < length; i++)
+	{
+		if (msg[i] == '^' && i + 1 < length && isdigit(msg[i + 1]))
+		{
+			int code = q3ToAnsi[(msg[i + 1] - '0') & 0x07];
+
+			memcpy(&out[written], "\033[1;", 4);
+			written += 4;
+
+			if (code >= 10)
+				out[written++] = '0' + code / 10;
+
+			out[written++] = '0' + code % 10;
+			out[written++] = 'm';
+			text = false;
+			i++;
+		}
+		else if (msg[i] == '\n')
+		{
+			memcpy(&out[written], "\033[0m\n", 5);
+			written += 5;
+			text = false;
+		}
+		else
+		{
+			out[written++] = msg[i];
+			text = true;
+		}
+	}
+
+	if (text)
+	{
+		memcpy(&out[written], "\033[0m", 4);
+		written += 4;
+	}
+
+	return written;
+}
+
+// Writes the queued records the writer thread has not picked up yet, on the calling thread.
+// Records before the tail may already be overwritten, the batch the writer thread holds is
+// left to it.
+static void async_log_drain()
+{
+	static char record[ASYNC_LOG_MAX_RECORD];
+	static char translated[ASYNC_LOG_MAX_RECORD * 5 + 4];
+
+	unsigned int head = byte_ring_readable(&async_log_ring);
+	unsigned int position = __atomic_load_n(&async_log_ring.tail, __ATOMIC_ACQUIRE);
+
+	while (position != head)
+	{
+		unsigned int header;
+		byte_ring_copy_out(&async_log_ring, position, &header, ASYNC_LOG_HEADER);
+
+		int recordLength = header >> 1;
+
+		// the process is crashing, a header that makes no sense ends the drain
+		if (recordLength > ASYNC_LOG_MAX_RECORD || ASYNC_LOG_HEADER + (unsigned int)recordLength > head - position)
+			break;
+
+		byte_ring_copy_out(&async_log_ring, position + ASYNC_LOG_HEADER, record, recordLength);
+		position += ASYNC_LOG_HEADER + recordLength;
+
+		if (header & 1)
+			byte_ring_output(STDOUT_FILENO, translated, async_log_translate(record, recordLength, translated));
+		else
+			byte_ring_output(STDOUT_FILENO, record, recordLength);
+	}
+
+	byte_ring_consume(&async_log_ring, head);
+	byte_ring_written(&async_log_ring, head);
+}
+
+// From here on nothing is queued. Safe in signal handlers, a batch the writer thread
+// is writing at that moment may be cut short if the process ends first.
+static void async_log_shutdown()
+{
+	if (!async_log_started || getpid() != async_log_pid)
+		return;
+
+	if (__atomic_exchange_n(&async_log_direct, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	async_log_drain();
+}
+
+static void async_log_fatal(int sig)
+{
+	async_log_shutdown();
+
+	// the previous handler gets the signal again once this one returns
+	for (unsigned int i = 0; i < sizeof(async_log_fatal_signals) / sizeof(async_log_fatal_signals[0]); i++)
+	{
+		if (async_log_fatal_signals[i] == sig)
+			sigaction(sig, &async_log_previous[i], NULL);
+	}
+
+	raise(sig);
+}
+
+// The engine leaves through _exit on some error paths, atexit handlers do not run there
+extern "C" void _exit(int status)
+{
+	async_log_shutdown();
+	syscall(SYS_exit_group, status);
+
+	while (true)
+		;
+}
+
+static void *async_log_thread(void *unused)
+{
+	static char batch[ASYNC_LOG_BATCH_SIZE];
+	static char record[ASYNC_LOG_MAX_RECORD];
+	unsigned int reported = 0;
+
+	while (!__atomic_load_n(&async_log_direct, __ATOMIC_ACQUIRE))
+	{
+		unsigned int head = byte_ring_readable(&async_log_ring);
+		unsigned int tail = async_log_ring.tail;
+		int length = 0;
+
+		while (tail != head)
+		{
+			unsigned int header;
+			byte_ring_copy_out(&async_log_ring, tail, &header, ASYNC_LOG_HEADER);
+
+			int recordLength = header >> 1;
+
+			// colored records grow when translated
+			if (length + recordLength * 5 + 4 > ASYNC_LOG_BATCH_SIZE)
+				break;
+
+			byte_ring_copy_out(&async_log_ring, tail + ASYNC_LOG_HEADER, record, recordLength);
+			tail += ASYNC_LOG_HEADER + recordLength;
+
+			if (header & 1)
+				length += async_log_translate(record, recordLength, &batch[length]);
+			else
+			{
+				memcpy(&batch[length], record, recordLength);
+				length += recordLength;
+			}
+		}
+
+		// the space is free again as soon as the records are copied
+		byte_ring_consume(&async_log_ring, tail);
+
+		unsigned int lost = __atomic_load_n(&async_log_lost, __ATOMIC_RELAXED);
+
+		if (lost != reported && length < ASYNC_LOG_BATCH_SIZE - 64)
+		{
+			length += snprintf(&batch[length], 64, "> [LIBCOD] %u console lines dropped\n", lost - reported);
+			reported = lost;
+		}
+
+		if (length == 0)
+		{
+			usleep(ASYNC_LOG_INTERVAL * 1000);
+			continue;
+		}
+
+		byte_ring_output(STDOUT_FILENO, batch, length);
+		byte_ring_written(&async_log_ring, tail);
+	}
+
+	return NULL;
+}
+
+// Called with the stdout lock held. Never blocks, when the ring is full the text is dropped and counted
+int async_log_write(const char *data, int length, int colored)
+{
+	if (__atomic_load_n(&async_log_direct, __ATOMIC_ACQUIRE))
+	{
+		static char translated[ASYNC_LOG_MAX_RECORD * 5 + 4];
+
+		while (length > 0)
+		{
+			int chunk = length < ASYNC_LOG_MAX_RECORD ? length : ASYNC_LOG_MAX_RECORD;
+
+			if (colored)
+				byte_ring_output(STDOUT_FILENO, translated, async_log_translate(data, chunk, translated));
+			else
+				byte_ring_output(STDOUT_FILENO, data, chunk);
+
+			data += chunk;
+			length -= chunk;
+		}
+
+		return 1;
+	}
+
+	while (length > 0)
+	{
+		int chunk = length < ASYNC_LOG_MAX_RECORD ? length : ASYNC_LOG_MAX_RECORD;
+
+		if (byte_ring_space(&async_log_ring) < (unsigned int)(ASYNC_LOG_HEADER + chunk))
+		{
+			unsigned int lines = 0;
+
+			for (int i = 0; i < length; i++)
+			{
+				if (data[i] == '\n')
+					lines++;
+			}
+
+			__atomic_add_fetch(&async_log_lost, lines ? lines : 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		unsigned int header = (chunk << 1) | (colored ? 1 : 0);
+
+		byte_ring_copy_in(&async_log_ring, async_log_ring.head, &header, ASYNC_LOG_HEADER);
+		byte_ring_copy_in(&async_log_ring, async_log_ring.head + ASYNC_LOG_HEADER, data, chunk);
+		byte_ring_commit(&async_log_ring, ASYNC_LOG_HEADER + chunk);
+
+		data += chunk;
+		length -= chunk;
+	}
+
+	return 1;
+}
+
+static ssize_t async_log_stream_write(void *cookie, const char *buf, size_t size)
+{
+	async_log_write(buf, size, 0);
+
+	// dropped text is counted, it is not an error for the caller
+	return size;
+}
+
+int async_log_running()
+{
+	return async_log_started;
+}
+
+unsigned int async_log_dropped()
+{
+	return __atomic_load_n(&async_log_lost, __ATOMIC_RELAXED);
+}
+
+// Gives the writer thread a moment, then writes whatever is left and stops queueing.
+// Runs at exit, so the last lines before it are not lost.
+void async_log_flush()
+{
+	if (!async_log_started)
+		return;
+
+	fflush(stdout);
+	byte_ring_wait(&async_log_ring, 1000);
+	async_log_shutdown();
+}
+
+// Replaces stdout with a line buffered stream that only copies into the ring
+int async_log_start()
+{
+	if (async_log_started)
+		return 1;
+
+	cookie_io_functions_t functions;
+	memset(&functions, 0, sizeof(functions));
+	functions.write = async_log_stream_write;
+
+	FILE *stream = fopencookie(NULL, "w", functions);
+
+	if (stream == NULL)
+		return 0;
+
+	setvbuf(stream, NULL, _IOLBF, ASYNC_LOG_MAX_RECORD);
+
+	if (!byte_ring_start_writer(async_log_thread, async_log_flush))
+	{
+		fclose(stream);
+		return 0;
+	}
+
+	fflush(stdout);
+	stdout = stream;
+	async_log_pid = getpid();
+	async_log_started = true;
+
+	// a crash writes out the queue before the previous handler runs
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = async_log_fatal;
+	sigemptyset(&action.sa_mask);
+
+	for (unsigned int i = 0; i < sizeof(async_log_fatal_signals) / sizeof(async_log_fatal_signals[0]); i++)
+		sigaction(async_log_fatal_signals[i], &action, &async_log_previous[i]);
+
+	return 1;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _ASYNC_LOG_HPP_
+#define _ASYNC_LOG_HPP_
+
+#include "gsc.hpp"
+
+#define ASYNC_LOG_RING_SIZE ( 1024 * 1024 ) // power of two
+#define ASYNC_LOG_MAX_RECORD 4096
+#define ASYNC_LOG_BATCH_SIZE ( 64 * 1024 )
+#define ASYNC_LOG_INTERVAL 10 // ms the writer sleeps when there is nothing to write
+
+int async_log_start();
+int async_log_running();
+int async_log_write(const char *data, int length, int colored);
+unsigned int async_log_dropped();
+void async_log_flush();
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef _BYTE_RING_HPP_
+#define _BYTE_RING_HPP_
+
+#include "gsc.hpp"
+
+#include <pthread.h>
+#include <errno.h>
+
+// Single producer, single consumer byte ring for the background writers. Positions only
+// grow and wrap with the power of two size, head - tail is the space in use.
+typedef struct
+{
+	byte *data;
+	unsigned int size;
+	unsigned int head; // advanced by the producer
+	unsigned int tail; // advanced by the consumer once records are copied out
+	unsigned int written; // advanced by the consumer once records reached their output
+} byteRing_t;
+
+#define BYTE_RING_INIT(buffer) { (byte *)(buffer), sizeof(buffer), 0, 0, 0 }
+
+inline void byte_ring_copy_in(byteRing_t *ring, unsigned int position, const void *data, unsigned int length)
+{
+	unsigned int offset = position & (ring->size - 1);
+	unsigned int first = length < ring->size - offset ? length : ring->size - offset;
+
+	memcpy(&ring->data[offset], data, first);
+	memcpy(ring->data, (const byte *)data + first, length - first);
+}
+
+inline void byte_ring_copy_out(const byteRing_t *ring, unsigned int position, void *data, unsigned int length)
+{
+	unsigned int offset = position & (ring->size - 1);
+	unsigned int first = length < ring->size - offset ? length : ring->size - offset;
+
+	memcpy(data, &ring->data[offset], first);
+	memcpy((byte *)data + first, ring->data, length - first);
+}
+
+// Producer side: free bytes, then copy_in at head and commit
+inline unsigned int byte_ring_space(const byteRing_t *ring)
+{
+	return ring->size - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+inline void byte_ring_commit(byteRing_t *ring, unsigned int length)
+{
+	__atomic_store_n(&ring->head, ring->head + length, __ATOMIC_RELEASE);
+}
+
+inline int byte_ring_push(byteRing_t *ring, const void *data, unsigned int length)
+{
+	if (byte_ring_space(ring) < length)
+		return 0;
+
+	byte_ring_copy_in(ring, ring->head, data, length);
+	byte_ring_commit(ring, length);
+
+	return 1;
+}
+
+// Consumer side: records up to the returned head may be copied out
+inline unsigned int byte_ring_readable(const byteRing_t *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+inline void byte_ring_consume(byteRing_t *ring, unsigned int tail)
+{
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+inline void byte_ring_written(byteRing_t *ring, unsigned int position)
+{
+	__atomic_store_n(&ring->written, position, __ATOMIC_RELEASE);
+}
+
+// Waits up to timeout ms for the consumer to write out what is queued now
+inline void byte_ring_wait(const byteRing_t *ring, int timeout)
+{
+	unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	for (int i = 0; i < timeout && __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE) != head; i++)
+		usleep(1000);
+}
+
+// write() until everything is out, async signal safe
+inline int byte_ring_output(int fd, const void *data, int length)
+{
+	const byte *ptr = (const byte *)data;
+
+	while (length > 0)
+	{
+		int written = write(fd, ptr, length);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return 0;
+		}
+
+		ptr += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+// Detached consumer thread, flush runs at exit so queued records are not lost
+inline int byte_ring_start_writer(void *(*writer)(void *), void (*flush)(void))
+{
+	pthread_t thread;
+
+	if (pthread_create(&thread, NULL, writer, NULL) != 0 || pthread_detach(thread) != 0)
+		return 0;
+
+	atexit(flush);
+
+	return 1;
+}
+
+#endif
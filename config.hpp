@@ -16,6 +16,30 @@
 // RATE LIMITER
 #define COMPILE_RATELIMITER 1
 
+// DNS RESOLVER
+#define COMPILE_RESOLVER 1
+
+// HTTP DOWNLOAD SERVER (1.2 and 1.3 wwwDownload)
+#define COMPILE_HTTPSERVER 1
+
+// ASYNCHRONOUS CONSOLE OUTPUT
+#define COMPILE_ASYNCLOG 1
+
+// BINARY EVENT LOG
+#define COMPILE_EVENTLOG 1
+
+// MAIN THREAD STALL WATCHDOG
+#define COMPILE_WATCHDOG 1
+
+// FRAME TIME STATISTICS
+#define COMPILE_PERFSTATS 1
+
+// METRICS ENDPOINT
+#define COMPILE_METRICS 1
+
+// SHARED MEMORY STATS
+#define COMPILE_SHMSTATS 1
+
 // EXTRA STUFF
 #ifdef EXTRA_CONFIG_INC
 #include "extra/config.hpp"
@@ -1,5 +1,8 @@
 #include "cracking.hpp"
 
+#define TRAMPOLINE_SIZE 32
+#define TRAMPOLINE_PAGE 4096
+
 void cracking_hook_function(int from, int to)
 {
 	int relative = to - (from+5); // +5 is the position of next opcode
@@ -13,15 +16,162 @@ void cracking_hook_call(int from, int to)
 	memcpy((void *)(from+1), &relative, 4); // set relative address with endian
 }
 
+static int cracking_modrm_length(unsigned char *modrm)
+{
+	int mod = modrm[0] >> 6;
+	int rm = modrm[0] & 7;
+	int length = 1;
+
+	if (mod == 3)
+		return length;
+
+	if (rm == 4)
+	{
+		length++; // sib
+
+		if (mod == 0 && (modrm[1] & 7) == 5)
+			length += 4;
+	}
+
+	if (mod == 1)
+		length += 1;
+	else if (mod == 2)
+		length += 4;
+	else if (mod == 0 && rm == 5)
+		length += 4;
+
+	return length;
+}
+
+// length of the instructions found in function prologues, 0 if unknown
+static int cracking_instruction_length(unsigned char *code, int *relative)
+{
+	*relative = 0;
+
+	switch (code[0])
+	{
+	case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57: // push reg
+	case 0x58: case 0x59: case 0x5A: case 0x5B: case 0x5C: case 0x5D: case 0x5E: case 0x5F: // pop reg
+	case 0x90: // nop
+		return 1;
+
+	case 0x6A: // push imm8
+		return 2;
+
+	case 0x68: // push imm32
+	case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBE: case 0xBF: // mov reg, imm32
+		return 5;
+
+	case 0xE8: // call rel32
+	case 0xE9: // jmp rel32
+		*relative = 1;
+		return 5;
+
+	case 0x01: case 0x03: case 0x09: case 0x0B: case 0x21: case 0x23: case 0x29: case 0x2B:
+	case 0x31: case 0x33: case 0x39: case 0x3B: case 0x85: case 0x89: case 0x8B: case 0x8D:
+		return 1 + cracking_modrm_length(code + 1);
+
+	case 0x83: // op r/m32, imm8
+		return 1 + cracking_modrm_length(code + 1) + 1;
+
+	case 0x81: // op r/m32, imm32
+	case 0xC7: // mov r/m32, imm32
+		return 1 + cracking_modrm_length(code + 1) + 4;
+
+	case 0x0F:
+		if (code[1] == 0xB6 || code[1] == 0xB7 || code[1] == 0xBE || code[1] == 0xBF) // movzx, movsx
+			return 2 + cracking_modrm_length(code + 2);
+
+		return 0;
+
+	default:
+		return 0;
+	}
+}
+
+// copies the instructions overwritten by the 5 byte jump into an executable stub that jumps back
+int cracking_trampoline(int from)
+{
+	static unsigned char *page = NULL;
+	static int used = TRAMPOLINE_PAGE;
+
+	unsigned char *code = (unsigned char *)from;
+	int length = 0;
+
+	while (length < 5)
+	{
+		int relative;
+		int size = cracking_instruction_length(code + length, &relative);
+
+		if (!size)
+		{
+			printf("> [LIBCOD] Cannot relocate opcode 0x%02X at 0x%08X\n", code[length], from + length);
+			return 0;
+		}
+
+		length += size;
+	}
+
+	if (used + TRAMPOLINE_SIZE > TRAMPOLINE_PAGE)
+	{
+		page = (unsigned char *)mmap(NULL, TRAMPOLINE_PAGE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (page == MAP_FAILED)
+		{
+			page = NULL;
+			return 0;
+		}
+
+		used = 0;
+	}
+
+	unsigned char *stub = page + used;
+	used += TRAMPOLINE_SIZE;
+
+	memcpy(stub, code, length);
+
+	// rel32 operands are relative to the next instruction, move them with the stub
+	for (int offset = 0; offset < length;)
+	{
+		int relative;
+		int size = cracking_instruction_length(code + offset, &relative);
+
+		if (relative)
+		{
+			int target = from + offset + size + *(int *)(code + offset + relative);
+			*(int *)(stub + offset + relative) = target - ((int)stub + offset + size);
+		}
+
+		offset += size;
+	}
+
+	cracking_hook_function((int)(stub + length), from + length);
+
+	return (int)stub;
+}
+
 cHook::cHook(int from, int to)
 {
 	this->from = from;
 	this->to = to;
+	this->trampoline = 0;
 }
 
 void cHook::hook()
 {
-	memcpy((void *)oldCode, (void *)from, 5);
+	// the detour stays in place, the original function is reached through the trampoline
+	if (!trampoline)
+	{
+		memcpy((void *)oldCode, (void *)from, 5);
+		trampoline = cracking_trampoline(from);
+	}
+
+	if (!trampoline)
+	{
+		printf("> [LIBCOD] Hook at 0x%08X not installed\n", from);
+		return;
+	}
+
 	cracking_hook_function(from, to);
 }
 
@@ -6,12 +6,14 @@
 
 void cracking_hook_function(int from, int to);
 void cracking_hook_call(int from, int to);
+int cracking_trampoline(int from);
 
 class cHook
 {
 public:
 	int from;
 	int to;
+	int trampoline; // relocated prologue of from, call this to reach the original function
 	unsigned char oldCode[5];
 	cHook(int from, int to);
 	void hook();
@@ -30,8 +30,10 @@
 
 #define MAX_CLIENTS 64
 #define PACKET_BACKUP 32
+#define PACKET_MASK ( PACKET_BACKUP - 1 )
 #define MAX_QPATH 64
 #define MAX_OSPATH 256
+#define MAX_INFO_STRING 1024
 #define FRAMETIME 50
 
 typedef unsigned char byte;
@@ -379,6 +381,7 @@ typedef struct
 typedef int	fileHandle_t;
 typedef void (*xfunction_t)();
 typedef void (*xmethod_t)(scr_entref_t);
+typedef void (*xcommand_t)(void);
 
 typedef struct scr_function_s
 {
@@ -629,10 +632,12 @@ struct leakyBucket_s
 {
 	netadrtype_t type;
 	unsigned char adr[4];
+	unsigned char prefix; // 32 for a single address, 24 for its subnet
 	int	lastTime;
-	signed char	burst;
+	int	burst;
 	long hash;
 	leakyBucket_t *prev, *next;
+	leakyBucket_t *lruPrev, *lruNext; // least recently used order, lruNext links the free list
 };
 
 typedef struct usercmd_s
@@ -6,10 +6,11 @@
 # ./doit.sh cod2_1_3
 
 cc="g++"
-options="-I. -m32 -fPIC -Wall"
+options="-I. -m32 -fPIC -Wall -std=gnu++11"
 
 mysql_variant=0
 pthread_link=""
+rt_link=""
 sqlite_found=0
 sqlite_libpath=""
 sqlite_libpath2=""
@@ -205,6 +206,53 @@ if [ "$(< config.hpp grep '#define COMPILE_WEAPONS' | grep -o '[0-9]')" == "1" ]
 	$cc $options $constants -c gsc_weapons.cpp -o objects_"$1"/gsc_weapons.opp
 fi
 
+if [ "$(< config.hpp grep '#define COMPILE_RESOLVER' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 NET_RESOLVER.CPP #####"
+	$cc $options $constants -c net_resolver.cpp -o objects_"$1"/net_resolver.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_HTTPSERVER' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 HTTP_SERVER.CPP #####"
+	$cc $options $constants -c http_server.cpp -o objects_"$1"/http_server.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_ASYNCLOG' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 ASYNC_LOG.CPP #####"
+	$cc $options $constants -c async_log.cpp -o objects_"$1"/async_log.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_EVENTLOG' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 EVENT_LOG.CPP #####"
+	$cc $options $constants -c event_log.cpp -o objects_"$1"/event_log.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_WATCHDOG' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 WATCHDOG.CPP #####"
+	$cc $options $constants -c watchdog.cpp -o objects_"$1"/watchdog.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_PERFSTATS' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 PERF_STATS.CPP #####"
+	$cc $options $constants -c perf_stats.cpp -o objects_"$1"/perf_stats.opp
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_METRICS' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 METRICS.CPP #####"
+	$cc $options $constants -c metrics.cpp -o objects_"$1"/metrics.opp
+	pthread_link="-lpthread"
+fi
+
+if [ "$(< config.hpp grep '#define COMPILE_SHMSTATS' | grep -o '[0-9]')" == "1" ]; then
+	echo "##### COMPILE $1 SHM_STATS.CPP #####"
+	$cc $options $constants -c shm_stats.cpp -o objects_"$1"/shm_stats.opp
+	rt_link="-lrt"
+fi
+
 if [ -d extra ]; then
 	echo "##### COMPILE $1 EXTRAS #####"
 	(
@@ -219,10 +267,11 @@ fi
 
 echo "##### COMPILE $1 LIBCOD.CPP #####"
 $cc $options $constants -c libcod.cpp -o objects_"$1"/libcod.opp
+pthread_link="-lpthread"
 
 echo "##### LINKING lib$1.so #####"
 objects="$(ls objects_$1/*.opp)"
-$cc -m32 -shared -L/lib32 -o bin/lib"$1".so -ldl $objects $pthread_link $mysql_link $sqlite_link
+$cc -m32 -shared -L/lib32 -o bin/lib"$1".so -ldl $objects $pthread_link $rt_link $mysql_link $sqlite_link
 rm objects_"$1" -r
 
 if [ $mysql_variant -gt 0 ]; then
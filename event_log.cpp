@@ -0,0 +1,392 @@
+#include "event_log.hpp"
+
+#if COMPILE_EVENTLOG == 1
+
+#include "byte_ring.hpp"
+
+#define EVENT_LOG_SLOTS ( EVENT_LOG_MAX_NAMES * 2 ) // power of two
+
+// Records are only appended by the game thread, the ring has one writer and one reader
+static byte event_log_buffer[EVENT_LOG_RING_SIZE];
+static byteRing_t event_log_ring = BYTE_RING_INIT(event_log_buffer);
+static unsigned int event_log_lost = 0;
+static bool event_log_started = false; // writer thread
+static bool event_log_enabled = false; // game thread accepts events
+
+// A new prefix is applied by the writer once the records queued before it are written
+static pthread_mutex_t event_log_switch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool event_log_switch = false;
+static unsigned int event_log_switch_at = 0;
+static char event_log_next_prefix[MAX_OSPATH];
+static int event_log_next_max_size = 0;
+
+// game thread: name lookup and the current base time
+static char event_log_names[EVENT_LOG_MAX_NAMES][EVENT_LOG_MAX_NAME + 1];
+static u_int16_t event_log_slots[EVENT_LOG_SLOTS]; // name id + 1, 0 when empty
+static int event_log_name_count = 0;
+static uint64_t event_log_base = 0;
+
+// writer thread: the output file and what a new file has to repeat
+static char event_log_prefix[MAX_OSPATH];
+static int event_log_max_size = 0;
+static int event_log_fd = -1;
+static int event_log_size = 0;
+static int event_log_sequence = 0;
+static char event_log_file_names[EVENT_LOG_MAX_NAMES][EVENT_LOG_MAX_NAME + 1];
+static int event_log_file_name_count = 0;
+static uint64_t event_log_file_base = 0;
+
+static int event_log_output(const void *data, int length)
+{
+	return byte_ring_output(event_log_fd, data, length);
+}
+
+static void event_log_fill(eventLogRecord_t *record, int type, int length, int event, int client, int fields, unsigned int time)
+{
+	record->length = length;
+	record->type = type;
+	record->fields = fields;
+	record->event = event;
+	record->client = client;
+	record->pad = 0;
+	record->time = time;
+}
+
+static int event_log_output_base(uint64_t base)
+{
+	byte record[sizeof(eventLogRecord_t) + sizeof(uint64_t)];
+
+	event_log_fill((eventLogRecord_t *)record, EVENT_RECORD_BASE, sizeof(record), 0, -1, 0, 0);
+	memcpy(&record[sizeof(eventLogRecord_t)], &base, sizeof(uint64_t));
+
+	return event_log_output(record, sizeof(record));
+}
+
+static int event_log_output_name(int id, const char *name)
+{
+	byte record[sizeof(eventLogRecord_t) + EVENT_LOG_MAX_NAME];
+	int length = strlen(name);
+
+	event_log_fill((eventLogRecord_t *)record, EVENT_RECORD_NAME, sizeof(eventLogRecord_t) + length, id, -1, 0, 0);
+	memcpy(&record[sizeof(eventLogRecord_t)], name, length);
+
+	return event_log_output(record, sizeof(eventLogRecord_t) + length);
+}
+
+static void event_log_rotate()
+{
+	if (event_log_fd >= 0)
+		close(event_log_fd);
+
+	char path[MAX_OSPATH + 64];
+	time_t now = time(NULL);
+	struct tm local;
+
+	localtime_r(&now, &local);
+	snprintf(path, sizeof(path), "%s_%04i%02i%02i_%02i%02i%02i_%i.evl", event_log_prefix, local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec, event_log_sequence++);
+
+	event_log_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	event_log_size = 0;
+
+	if (event_log_fd < 0)
+	{
+		printf("> [LIBCOD] event log: could not open %s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	eventLogFileHeader_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+	header.version = EVENT_LOG_VERSION;
+
+	bool ok = event_log_output(&header, sizeof(header));
+
+	// later records of this file refer to the base and the names defined before it was opened
+	if (ok && event_log_file_base)
+		ok = event_log_output_base(event_log_file_base);
+
+	for (int i = 0; ok && i < event_log_file_name_count; i++)
+		ok = event_log_output_name(i, event_log_file_names[i]);
+
+	if (!ok)
+	{
+		printf("> [LIBCOD] event log: could not write %s: %s\n", path, strerror(errno));
+		close(event_log_fd);
+		event_log_fd = -1;
+	}
+}
+
+// Remembers the names and the base of records that went into the file, returns the number of events
+static int event_log_track(const byte *batch, int length)
+{
+	int events = 0;
+
+	for (int offset = 0; offset < length; offset += ((const eventLogRecord_t *)&batch[offset])->length)
+	{
+		const eventLogRecord_t *record = (const eventLogRecord_t *)&batch[offset];
+		const byte *payload = &batch[offset + sizeof(eventLogRecord_t)];
+		int payloadLength = record->length - sizeof(eventLogRecord_t);
+
+		if (record->type == EVENT_RECORD_EVENT)
+			events++;
+		else if (record->type == EVENT_RECORD_BASE)
+			memcpy(&event_log_file_base, payload, sizeof(uint64_t));
+		else if (record->type == EVENT_RECORD_NAME && record->event == event_log_file_name_count)
+		{
+			memcpy(event_log_file_names[event_log_file_name_count], payload, payloadLength);
+			event_log_file_names[event_log_file_name_count][payloadLength] = '\0';
+			event_log_file_name_count++;
+		}
+	}
+
+	return events;
+}
+
+static void *event_log_thread(void *unused)
+{
+	static byte batch[EVENT_LOG_BATCH_SIZE];
+
+	while (true)
+	{
+		unsigned int head = byte_ring_readable(&event_log_ring);
+		unsigned int tail = event_log_ring.tail;
+		int length = 0;
+
+		pthread_mutex_lock(&event_log_switch_mutex);
+		bool switching = event_log_switch;
+		unsigned int switchAt = event_log_switch_at;
+		pthread_mutex_unlock(&event_log_switch_mutex);
+
+		// records after the switch belong to the next file
+		if (switching && switchAt - tail < head - tail)
+			head = switchAt;
+
+		while (tail != head)
+		{
+			u_int16_t recordLength;
+			byte_ring_copy_out(&event_log_ring, tail, &recordLength, sizeof(recordLength));
+
+			if (length + recordLength > EVENT_LOG_BATCH_SIZE)
+				break;
+
+			byte_ring_copy_out(&event_log_ring, tail, &batch[length], recordLength);
+			tail += recordLength;
+			length += recordLength;
+		}
+
+		byte_ring_consume(&event_log_ring, tail);
+
+		if (length == 0)
+		{
+			if (switching && tail == switchAt)
+			{
+				pthread_mutex_lock(&event_log_switch_mutex);
+				strcpy(event_log_prefix, event_log_next_prefix);
+				event_log_max_size = event_log_next_max_size;
+				event_log_switch = false;
+				pthread_mutex_unlock(&event_log_switch_mutex);
+
+				// the next batch opens a file with the new prefix
+				if (event_log_fd >= 0)
+					close(event_log_fd);
+
+				event_log_fd = -1;
+				continue;
+			}
+
+			usleep(EVENT_LOG_INTERVAL * 1000);
+			continue;
+		}
+
+		if (*event_log_prefix && (event_log_fd < 0 || event_log_size >= event_log_max_size))
+			event_log_rotate();
+
+		bool ok = event_log_fd >= 0 && event_log_output(batch, length);
+
+		if (event_log_fd >= 0 && !ok)
+		{
+			printf("> [LIBCOD] event log: write failed: %s\n", strerror(errno));
+
+			// a new file is tried with the next batch
+			close(event_log_fd);
+			event_log_fd = -1;
+		}
+
+		event_log_size += length;
+
+		int events = event_log_track(batch, length);
+
+		if (!ok)
+			__atomic_add_fetch(&event_log_lost, events, __ATOMIC_RELAXED);
+
+		byte_ring_written(&event_log_ring, tail);
+	}
+
+	return NULL;
+}
+
+static int event_log_push(const void *record, int length)
+{
+	return byte_ring_push(&event_log_ring, record, length);
+}
+
+static int event_log_name_id(const char *name)
+{
+	int length = strlen(name);
+
+	if (length == 0 || length > EVENT_LOG_MAX_NAME)
+		return -1;
+
+	unsigned int hash = 2166136261u;
+
+	for (int i = 0; i < length; i++)
+		hash = (hash ^ (byte)name[i]) * 16777619u;
+
+	unsigned int slot = hash & (EVENT_LOG_SLOTS - 1);
+
+	while (event_log_slots[slot])
+	{
+		int id = event_log_slots[slot] - 1;
+
+		if (strcmp(event_log_names[id], name) == 0)
+			return id;
+
+		slot = (slot + 1) & (EVENT_LOG_SLOTS - 1);
+	}
+
+	if (event_log_name_count == EVENT_LOG_MAX_NAMES)
+		return -1;
+
+	// the name goes into the ring before the first event using it
+	byte record[sizeof(eventLogRecord_t) + EVENT_LOG_MAX_NAME];
+
+	event_log_fill((eventLogRecord_t *)record, EVENT_RECORD_NAME, sizeof(eventLogRecord_t) + length, event_log_name_count, -1, 0, 0);
+	memcpy(&record[sizeof(eventLogRecord_t)], name, length);
+
+	if (!event_log_push(record, sizeof(eventLogRecord_t) + length))
+		return -1;
+
+	strcpy(event_log_names[event_log_name_count], name);
+	event_log_slots[slot] = event_log_name_count + 1;
+
+	return event_log_name_count++;
+}
+
+// Game thread only. fields holds count encoded fields, nothing is written when the ring is full
+int event_log_append(const char *name, int client, const byte *fields, int length, int count)
+{
+	if (!event_log_enabled)
+		return 0;
+
+	if (length + (int)sizeof(eventLogRecord_t) > EVENT_LOG_MAX_RECORD || count > 255)
+		return 0;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	uint64_t now = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	// keeps the time of a record in 32 bits
+	if (!event_log_base || now < event_log_base || now - event_log_base >= EVENT_LOG_BASE_INTERVAL)
+	{
+		byte base[sizeof(eventLogRecord_t) + sizeof(uint64_t)];
+
+		event_log_fill((eventLogRecord_t *)base, EVENT_RECORD_BASE, sizeof(base), 0, -1, 0, 0);
+		memcpy(&base[sizeof(eventLogRecord_t)], &now, sizeof(uint64_t));
+
+		if (!event_log_push(base, sizeof(base)))
+		{
+			__atomic_add_fetch(&event_log_lost, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		event_log_base = now;
+	}
+
+	int id = event_log_name_id(name);
+
+	if (id < 0)
+	{
+		__atomic_add_fetch(&event_log_lost, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	byte record[EVENT_LOG_MAX_RECORD];
+
+	event_log_fill((eventLogRecord_t *)record, EVENT_RECORD_EVENT, sizeof(eventLogRecord_t) + length, id, client, count, now - event_log_base);
+	memcpy(&record[sizeof(eventLogRecord_t)], fields, length);
+
+	if (!event_log_push(record, sizeof(eventLogRecord_t) + length))
+	{
+		__atomic_add_fetch(&event_log_lost, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	return 1;
+}
+
+int event_log_running()
+{
+	return event_log_enabled;
+}
+
+unsigned int event_log_dropped()
+{
+	return __atomic_load_n(&event_log_lost, __ATOMIC_RELAXED);
+}
+
+// Waits a moment for queued events, so the last ones before an exit are not lost
+void event_log_flush()
+{
+	if (!event_log_started)
+		return;
+
+	byte_ring_wait(&event_log_ring, 1000);
+}
+
+static void event_log_set_prefix(const char *prefix, int maxSize)
+{
+	pthread_mutex_lock(&event_log_switch_mutex);
+	memset(event_log_next_prefix, 0, sizeof(event_log_next_prefix));
+	strncpy(event_log_next_prefix, prefix, sizeof(event_log_next_prefix) - 1);
+	event_log_next_max_size = maxSize > 0 ? maxSize : 64 * 1024 * 1024;
+	event_log_switch_at = event_log_ring.head;
+	event_log_switch = true;
+	pthread_mutex_unlock(&event_log_switch_mutex);
+}
+
+// Files are named <prefix>_<date>_<time>_<n>.evl, a new one is started after maxSize bytes.
+// Calling it again switches to a new prefix, events queued before go to the old file.
+int event_log_start(const char *prefix, int maxSize)
+{
+	if (!*prefix)
+		return 0;
+
+	if (!event_log_started)
+	{
+		if (!byte_ring_start_writer(event_log_thread, event_log_flush))
+		{
+			Com_Printf("event_log_start() error creating event log thread!\n");
+			return 0;
+		}
+
+		event_log_started = true;
+	}
+
+	event_log_set_prefix(prefix, maxSize);
+	event_log_enabled = true;
+
+	return 1;
+}
+
+// Events are refused from here on, the current file is closed once the queue is written
+void event_log_stop()
+{
+	if (!event_log_enabled)
+		return;
+
+	event_log_enabled = false;
+	event_log_set_prefix("", 0);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _EVENT_LOG_HPP_
+#define _EVENT_LOG_HPP_
+
+#include "gsc.hpp"
+#include "event_log_format.hpp"
+
+#define EVENT_LOG_RING_SIZE ( 1024 * 1024 ) // power of two
+#define EVENT_LOG_BATCH_SIZE ( 64 * 1024 )
+#define EVENT_LOG_MAX_RECORD 1024
+#define EVENT_LOG_MAX_NAMES 1024
+#define EVENT_LOG_MAX_NAME 64
+#define EVENT_LOG_BASE_INTERVAL 3600000 // ms between base records
+#define EVENT_LOG_INTERVAL 100 // ms the writer sleeps when there is nothing to write
+
+int event_log_start(const char *prefix, int maxSize);
+void event_log_stop();
+int event_log_running();
+int event_log_append(const char *name, int client, const byte *fields, int length, int count);
+unsigned int event_log_dropped();
+void event_log_flush();
+
+#endif
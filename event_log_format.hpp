@@ -0,0 +1,52 @@
+#ifndef _EVENT_LOG_FORMAT_HPP_
+#define _EVENT_LOG_FORMAT_HPP_
+
+/* on-disk format of the binary event log, shared with tools/eventlog_decode.cpp */
+#include <stdint.h>
+
+#define EVENT_LOG_MAGIC "CODEVLOG"
+#define EVENT_LOG_VERSION 1
+
+// Every file starts with the header, a base record and the names used so far,
+// so each file can be decoded on its own. Values are little endian.
+enum
+{
+	EVENT_RECORD_EVENT,
+	EVENT_RECORD_NAME, // event is the id, followed by the name without terminator
+	EVENT_RECORD_BASE // followed by the unix time in ms as uint64_t, later times are relative to it
+};
+
+// Each event field is a type byte followed by its value
+enum
+{
+	EVENT_FIELD_UNDEFINED, // no value
+	EVENT_FIELD_INT, // int32_t
+	EVENT_FIELD_FLOAT, // float
+	EVENT_FIELD_VECTOR, // 3 floats
+	EVENT_FIELD_STRING, // uint8_t length, then the characters
+	EVENT_FIELD_ENTITY // uint16_t entity number
+};
+
+#pragma pack(push, 1)
+
+typedef struct
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+} eventLogFileHeader_t;
+
+typedef struct
+{
+	uint16_t length; // whole record, header included
+	uint8_t type;
+	uint8_t fields;
+	uint16_t event;
+	int8_t client; // -1 when the event has no player
+	uint8_t pad;
+	uint32_t time; // ms since the last base record
+} eventLogRecord_t;
+
+#pragma pack(pop)
+
+#endif
@@ -69,6 +69,15 @@ static const SL_ConvertToString_t SL_ConvertToString = (SL_ConvertToString_t)0x0
 static const SL_ConvertToString_t SL_ConvertToString = (SL_ConvertToString_t)0x080A4458;
 #endif
 
+typedef unsigned int (*SL_GetString_t)(const char *str, unsigned int user);
+#if COD_VERSION == COD2_1_0
+static const SL_GetString_t SL_GetString = (SL_GetString_t)0x08079290;
+#elif COD_VERSION == COD2_1_2
+static const SL_GetString_t SL_GetString = (SL_GetString_t)0x08079814;
+#elif COD_VERSION == COD2_1_3
+static const SL_GetString_t SL_GetString = (SL_GetString_t)0x080798E0;
+#endif
+
 typedef int (*Scr_GetFunctionHandle_t)(const char* scriptName, const char* labelName, int isNeeded);
 #if COD_VERSION == COD2_1_0
 static const Scr_GetFunctionHandle_t Scr_GetFunctionHandle = (Scr_GetFunctionHandle_t)0x0810DD70;
@@ -78,6 +87,15 @@ static const Scr_GetFunctionHandle_t Scr_GetFunctionHandle = (Scr_GetFunctionHan
 static const Scr_GetFunctionHandle_t Scr_GetFunctionHandle = (Scr_GetFunctionHandle_t)0x08110208;
 #endif
 
+typedef void (*Cmd_AddCommand_t)(const char *cmd_name, xcommand_t function);
+#if COD_VERSION == COD2_1_0
+static const Cmd_AddCommand_t Cmd_AddCommand = (Cmd_AddCommand_t)0x080604B2;
+#elif COD_VERSION == COD2_1_2
+static const Cmd_AddCommand_t Cmd_AddCommand = (Cmd_AddCommand_t)0x080606BE;
+#elif COD_VERSION == COD2_1_3
+static const Cmd_AddCommand_t Cmd_AddCommand = (Cmd_AddCommand_t)0x080606B6;
+#endif
+
 typedef char * (*Cmd_Argv_t)(int arg);
 #if COD_VERSION == COD2_1_0
 static const Cmd_Argv_t Cmd_Argv = (Cmd_Argv_t)0x0806001C;
@@ -385,6 +403,15 @@ static const Scr_FreeThread_t Scr_FreeThread = (Scr_FreeThread_t)0x0808410A;
 static const Scr_FreeThread_t Scr_FreeThread = (Scr_FreeThread_t)0x080841D6;
 #endif
 
+typedef void (*Scr_NotifyNum_t)(int entnum, unsigned int classnum, unsigned int stringValue, unsigned int paramcount);
+#if COD_VERSION == COD2_1_0
+static const Scr_NotifyNum_t Scr_NotifyNum = (Scr_NotifyNum_t)0x0808442C;
+#elif COD_VERSION == COD2_1_2
+static const Scr_NotifyNum_t Scr_NotifyNum = (Scr_NotifyNum_t)0x080849A8;
+#elif COD_VERSION == COD2_1_3
+static const Scr_NotifyNum_t Scr_NotifyNum = (Scr_NotifyNum_t)0x08084A74;
+#endif
+
 typedef void (*SVC_RemoteCommand_t)(netadr_t from, msg_t *msg);
 #if COD_VERSION == COD2_1_0
 static const SVC_RemoteCommand_t SVC_RemoteCommand = (SVC_RemoteCommand_t)0x080951B4;
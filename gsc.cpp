@@ -1,14 +1,12 @@
 #include "gsc.hpp"
 
-const char *stackGetParamTypeAsString(int param)
-{
-	if (param >= Scr_GetNumParam())
-		return "UNDEFINED";
-
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
+#if COMPILE_WATCHDOG == 1
+#include "watchdog.hpp"
+#endif
 
-	switch (var->type)
+const char *stackGetTypeName(int type)
+{
+	switch (type)
 	{
 	case 0:
 		return "UNDEFINED";
@@ -87,6 +85,17 @@ const char *stackGetParamTypeAsString(int param)
 	}
 }
 
+const char *stackGetParamTypeAsString(int param)
+{
+	if (param >= Scr_GetNumParam())
+		return "UNDEFINED";
+
+	VariableValue *var;
+	var = &scrVmPub.top[-param];
+
+	return stackGetTypeName(var->type);
+}
+
 void NULL_FUNC(void) {}
 
 scr_function_t scriptFunctions[] =
@@ -100,6 +109,9 @@ scr_function_t scriptFunctions[] =
 	{"exec_async_create", gsc_exec_async_create, 0},
 	{"exec_async_create_nosave", gsc_exec_async_create_nosave, 0},
 	{"exec_async_checkdone", gsc_exec_async_checkdone, 0},
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	{"exec_async_create_await", gsc_exec_async_create_await, 0},
+#endif
 #endif
 
 #if COMPILE_MEMORY == 1
@@ -137,6 +149,9 @@ scr_function_t scriptFunctions[] =
 	{"mysql_async_getresult_and_free", gsc_mysql_async_getresult_and_free, 0},
 	{"mysql_async_initializer", gsc_mysql_async_initializer, 0},
 	{"mysql_reuse_connection", gsc_mysql_reuse_connection, 0},
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	{"mysql_async_create_query_await", gsc_mysql_async_create_query_await, 0},
+#endif
 #endif
 
 #if COMPILE_MYSQL_VORON == 1
@@ -170,10 +185,14 @@ scr_function_t scriptFunctions[] =
 	{"async_mysql_fetch_row", gsc_async_mysql_fetch_row, 0},
 	{"async_mysql_free_task", gsc_async_mysql_free_task, 0},
 	{"async_mysql_real_escape_string", gsc_async_mysql_real_escape_string, 0},
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	{"async_mysql_create_query_await", gsc_async_mysql_create_query_await, 0},
+#endif
 #endif
 
 #if COMPILE_PLAYER == 1
 	{"kick2", gsc_kick_slot, 0},
+	{"getallnetstats", gsc_getallnetstats, 0},
 #endif
 
 #if COMPILE_SQLITE == 1
@@ -185,11 +204,23 @@ scr_function_t scriptFunctions[] =
 	{"async_sqlite_create_query", gsc_async_sqlite_create_query, 0},
 	{"async_sqlite_create_query_nosave", gsc_async_sqlite_create_query_nosave, 0},
 	{"async_sqlite_checkdone", gsc_async_sqlite_checkdone, 0},
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	{"async_sqlite_create_query_await", gsc_async_sqlite_create_query_await, 0},
+#endif
 #endif
 
 #if COMPILE_UTILS == 1
 	{"printf", gsc_utils_printf, 0},
 	{"printoutofband", gsc_utils_outofbandprint, 0},
+#if COMPILE_RESOLVER == 1
+	{"resolve_async", gsc_utils_resolve_async, 0},
+#endif
+#if COMPILE_EVENTLOG == 1
+	{"logevent", gsc_utils_logevent, 0},
+#endif
+#if COMPILE_PERFSTATS == 1
+	{"getperfstats", gsc_utils_getperfstats, 0},
+#endif
 	{"getarraykeys", gsc_utils_getarraykeys, 0},
 	{"getascii", gsc_utils_getAscii, 0},
 	{"toupper", gsc_utils_toupper, 0},
@@ -199,6 +230,8 @@ scr_function_t scriptFunctions[] =
 	{"file_link", gsc_utils_file_link, 0},
 	{"file_unlink", gsc_utils_file_unlink, 0},
 	{"file_exists", gsc_utils_file_exists, 0},
+	{"preloadmap", gsc_utils_preloadmap, 0},
+	{"getpreloadstatus", gsc_utils_getpreloadstatus, 0},
 	{"fs_loaddir", gsc_utils_FS_LoadDir, 0},
 	{"gettype", gsc_utils_getType, 0},
 	{"float", gsc_utils_float, 0},
@@ -253,6 +286,11 @@ scr_function_t scriptFunctions[] =
 	{"getloadedweapons", gsc_weapons_getloadedweapons, 0},
 #endif
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	{"scriptprofile_dump", gsc_scriptprofile_dump, 0},
+	{"scriptprofile_reset", gsc_scriptprofile_reset, 0},
+#endif
+
 #ifdef EXTRA_FUNCTIONS_INC
 #include "extra/functions.hpp"
 #endif
@@ -260,6 +298,37 @@ scr_function_t scriptFunctions[] =
 	{NULL, NULL, 0} /* terminator */
 };
 
+/* both tables are sorted once at load, lookups during script compilation use a binary search */
+#define SCRIPT_TABLE_SIZE(table) (sizeof(table) / sizeof(table[0]) - 1) // without terminator
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+extern cvar_t *sv_scriptProfile;
+
+static xfunction_t scr_profile_function(int index);
+static xmethod_t scr_profile_method(int index);
+
+// Bound whether sv_watchdog is set or not, it can be turned on over rcon in the middle of
+// a map and the builtins are only looked up when the scripts are compiled
+static int scr_profile_watchdog()
+{
+#if COMPILE_WATCHDOG == 1
+	return watchdog_running();
+#else
+	return 0;
+#endif
+}
+#endif
+
+static int scr_function_compare(const void *a, const void *b)
+{
+	return strcasecmp(((const scr_function_t *)a)->name, ((const scr_function_t *)b)->name);
+}
+
+static int scr_function_find(const void *name, const void *func)
+{
+	return strcasecmp((const char *)name, ((const scr_function_t *)func)->name);
+}
+
 xfunction_t Scr_GetCustomFunction(const char **fname, qboolean *fdev)
 {
 	xfunction_t m = Scr_GetFunction(fname, fdev);
@@ -267,20 +336,20 @@ xfunction_t Scr_GetCustomFunction(const char **fname, qboolean *fdev)
 	if (m)
 		return m;
 
-	for (int i = 0; scriptFunctions[i].name; i++)
-	{
-		if (strcasecmp(*fname, scriptFunctions[i].name))
-			continue;
+	scr_function_t *func = (scr_function_t *)bsearch(*fname, scriptFunctions, SCRIPT_TABLE_SIZE(scriptFunctions), sizeof(scr_function_t), scr_function_find);
 
-		scr_function_t func = scriptFunctions[i];
+	if (func == NULL)
+		return NULL;
 
-		*fname = func.name;
-		*fdev = func.developer;
+	*fname = func->name;
+	*fdev = func->developer;
 
-		return func.call;
-	}
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	if ((sv_scriptProfile != NULL && sv_scriptProfile->boolean) || scr_profile_watchdog())
+		return scr_profile_function(func - scriptFunctions);
+#endif
 
-	return NULL;
+	return func->call;
 }
 
 scr_method_t scriptMethods[] =
@@ -355,6 +424,10 @@ scr_method_t scriptMethods[] =
 	{"disableitempickup", gsc_player_disableitempickup, 0},
 	{"enableitempickup", gsc_player_enableitempickup, 0},
 	{"getcurrentoffhandslotammo", gsc_player_getcurrentoffhandslotammo, 0},
+	{"getsmoothping", gsc_player_getsmoothping, 0},
+	{"getjitter", gsc_player_getjitter, 0},
+	{"getpacketloss", gsc_player_getpacketloss, 0},
+	{"getnetstats", gsc_player_getnetstats, 0},
 #endif
 
 #if COMPILE_SQLITE == 1
@@ -369,6 +442,16 @@ scr_method_t scriptMethods[] =
 	{NULL, NULL, 0} /* terminator */
 };
 
+static int scr_method_compare(const void *a, const void *b)
+{
+	return strcasecmp(((const scr_method_t *)a)->name, ((const scr_method_t *)b)->name);
+}
+
+static int scr_method_find(const void *name, const void *method)
+{
+	return strcasecmp((const char *)name, ((const scr_method_t *)method)->name);
+}
+
 xmethod_t Scr_GetCustomMethod(const char **fname, qboolean *fdev)
 {
 	xmethod_t m = Scr_GetMethod(fname, fdev);
@@ -376,20 +459,269 @@ xmethod_t Scr_GetCustomMethod(const char **fname, qboolean *fdev)
 	if (m)
 		return m;
 
-	for (int i = 0; scriptMethods[i].name; i++)
+	scr_method_t *func = (scr_method_t *)bsearch(*fname, scriptMethods, SCRIPT_TABLE_SIZE(scriptMethods), sizeof(scr_method_t), scr_method_find);
+
+	if (func == NULL)
+		return NULL;
+
+	*fname = func->name;
+	*fdev = func->developer;
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	if ((sv_scriptProfile != NULL && sv_scriptProfile->boolean) || scr_profile_watchdog())
+		return scr_profile_method(func - scriptMethods);
+#endif
+
+	return func->call;
+}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+/* builtin profiler, while sv_scriptProfile or the watchdog is on the VM gets timing thunks instead of the raw builtins,
+   the thunks also tell the watchdog which builtin is running */
+#define PROFILE_BUCKETS 32
+
+typedef struct
+{
+	unsigned int calls;
+	unsigned long long total;
+	unsigned long long max;
+	unsigned int histogram[PROFILE_BUCKETS]; // calls by log2 of their cycle count
+} scr_profile_t;
+
+scr_profile_t functionProfiles[SCRIPT_TABLE_SIZE(scriptFunctions) + 1];
+scr_profile_t methodProfiles[SCRIPT_TABLE_SIZE(scriptMethods) + 1];
+xfunction_t profiledFunctions[SCRIPT_TABLE_SIZE(scriptFunctions) + 1];
+xmethod_t profiledMethods[SCRIPT_TABLE_SIZE(scriptMethods) + 1];
+
+static inline unsigned long long scr_profile_rdtsc()
+{
+	unsigned int lo, hi;
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+static void scr_profile_record(scr_profile_t *profile, unsigned long long cycles)
+{
+	int bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+
+	if (bucket > PROFILE_BUCKETS - 1)
+		bucket = PROFILE_BUCKETS - 1;
+
+	profile->calls++;
+	profile->total += cycles;
+	profile->histogram[bucket]++;
+
+	if (cycles > profile->max)
+		profile->max = cycles;
+}
+
+template <int N>
+void profiled_function()
+{
+#if COMPILE_WATCHDOG == 1
+	const char *previous = watchdog_enter(scriptFunctions[N].name);
+#endif
+
+	unsigned long long start = scr_profile_rdtsc();
+	scriptFunctions[N].call();
+	scr_profile_record(&functionProfiles[N], scr_profile_rdtsc() - start);
+
+#if COMPILE_WATCHDOG == 1
+	watchdog_leave(previous);
+#endif
+}
+
+template <int N>
+void profiled_method(scr_entref_t entref)
+{
+#if COMPILE_WATCHDOG == 1
+	const char *previous = watchdog_enter(scriptMethods[N].name);
+#endif
+
+	unsigned long long start = scr_profile_rdtsc();
+	scriptMethods[N].call(entref);
+	scr_profile_record(&methodProfiles[N], scr_profile_rdtsc() - start);
+
+#if COMPILE_WATCHDOG == 1
+	watchdog_leave(previous);
+#endif
+}
+
+// one thunk per table entry, split in halves to keep the instantiation depth logarithmic
+template <int First, int Count>
+struct profiled_function_thunks
+{
+	static void fill()
+	{
+		profiled_function_thunks<First, Count / 2>::fill();
+		profiled_function_thunks<First + Count / 2, Count - Count / 2>::fill();
+	}
+};
+
+template <int First>
+struct profiled_function_thunks<First, 1>
+{
+	static void fill() { profiledFunctions[First] = profiled_function<First>; }
+};
+
+template <int First>
+struct profiled_function_thunks<First, 0>
+{
+	static void fill() {}
+};
+
+template <int First, int Count>
+struct profiled_method_thunks
+{
+	static void fill()
 	{
-		if (strcasecmp(*fname, scriptMethods[i].name))
+		profiled_method_thunks<First, Count / 2>::fill();
+		profiled_method_thunks<First + Count / 2, Count - Count / 2>::fill();
+	}
+};
+
+template <int First>
+struct profiled_method_thunks<First, 1>
+{
+	static void fill() { profiledMethods[First] = profiled_method<First>; }
+};
+
+template <int First>
+struct profiled_method_thunks<First, 0>
+{
+	static void fill() {}
+};
+
+static xfunction_t scr_profile_function(int index)
+{
+	return profiledFunctions[index];
+}
+
+static xmethod_t scr_profile_method(int index)
+{
+	return profiledMethods[index];
+}
+
+typedef struct
+{
+	const char *type;
+	const char *name;
+	scr_profile_t *profile;
+} scr_profile_entry_t;
+
+static int scr_profile_compare(const void *a, const void *b)
+{
+	unsigned long long totalA = ((const scr_profile_entry_t *)a)->profile->total;
+	unsigned long long totalB = ((const scr_profile_entry_t *)b)->profile->total;
+
+	return (totalA < totalB) - (totalA > totalB);
+}
+
+void Scr_PrintProfile()
+{
+	scr_profile_entry_t entries[SCRIPT_TABLE_SIZE(scriptFunctions) + SCRIPT_TABLE_SIZE(scriptMethods) + 1];
+	int count = 0;
+
+	for (unsigned int i = 0; i < SCRIPT_TABLE_SIZE(scriptFunctions); i++)
+	{
+		if (!functionProfiles[i].calls)
+			continue;
+
+		entries[count].type = "function";
+		entries[count].name = scriptFunctions[i].name;
+		entries[count].profile = &functionProfiles[i];
+		count++;
+	}
+
+	for (unsigned int i = 0; i < SCRIPT_TABLE_SIZE(scriptMethods); i++)
+	{
+		if (!methodProfiles[i].calls)
 			continue;
 
-		scr_method_t func = scriptMethods[i];
+		entries[count].type = "method";
+		entries[count].name = scriptMethods[i].name;
+		entries[count].profile = &methodProfiles[i];
+		count++;
+	}
+
+	qsort(entries, count, sizeof(scr_profile_entry_t), scr_profile_compare);
+
+	Com_Printf("type     name                                calls        total cycles   avg cycles   max cycles  histogram (log2 cycles:calls)\n");
+
+	for (int i = 0; i < count; i++)
+	{
+		scr_profile_t *profile = entries[i].profile;
+		char histogram[MAX_STRINGLENGTH];
+		int len = 0;
+
+		histogram[0] = '\0';
+
+		for (int bucket = 0; bucket < PROFILE_BUCKETS && len < (int)sizeof(histogram); bucket++)
+		{
+			if (profile->histogram[bucket])
+				len += snprintf(histogram + len, sizeof(histogram) - len, " %d:%u", bucket, profile->histogram[bucket]);
+		}
+
+		Com_Printf("%-8s %-32s %9u %19llu %12llu %12llu %s\n", entries[i].type, entries[i].name, profile->calls, profile->total, profile->total / profile->calls, profile->max, histogram);
+	}
+
+	if (!sv_scriptProfile->boolean)
+		Com_Printf("sv_scriptProfile is disabled, it takes effect when the scripts are loaded\n");
+}
 
-		*fname = func.name;
-		*fdev = func.developer;
+void Scr_ResetProfile()
+{
+	memset(functionProfiles, 0, sizeof(functionProfiles));
+	memset(methodProfiles, 0, sizeof(methodProfiles));
+}
 
-		return func.call;
+void Scr_ProfileCommand()
+{
+	if (Cmd_Argc() > 1 && !strcasecmp(Cmd_Argv(1), "reset"))
+	{
+		Scr_ResetProfile();
+		Com_Printf("Script profile reset\n");
+		return;
 	}
 
-	return NULL;
+	Scr_PrintProfile();
+}
+
+void gsc_scriptprofile_dump()
+{
+	Scr_PrintProfile();
+	stackPushBool(qtrue);
+}
+
+void gsc_scriptprofile_reset()
+{
+	Scr_ResetProfile();
+	stackPushBool(qtrue);
+}
+#endif
+
+void Scr_InitCustomFunctions()
+{
+	qsort(scriptFunctions, SCRIPT_TABLE_SIZE(scriptFunctions), sizeof(scr_function_t), scr_function_compare);
+	qsort(scriptMethods, SCRIPT_TABLE_SIZE(scriptMethods), sizeof(scr_method_t), scr_method_compare);
+
+	// a duplicate would make the lookup pick either entry
+	for (unsigned int i = 1; i < SCRIPT_TABLE_SIZE(scriptFunctions); i++)
+	{
+		if (!strcasecmp(scriptFunctions[i - 1].name, scriptFunctions[i].name))
+			printf("> [LIBCOD] Duplicate script function: %s\n", scriptFunctions[i].name);
+	}
+
+	for (unsigned int i = 1; i < SCRIPT_TABLE_SIZE(scriptMethods); i++)
+	{
+		if (!strcasecmp(scriptMethods[i - 1].name, scriptMethods[i].name))
+			printf("> [LIBCOD] Duplicate script method: %s\n", scriptMethods[i].name);
+	}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	profiled_function_thunks<0, SCRIPT_TABLE_SIZE(scriptFunctions)>::fill();
+	profiled_method_thunks<0, SCRIPT_TABLE_SIZE(scriptMethods)>::fill();
+#endif
 }
 
 int stackGetParamType(int param)
@@ -423,8 +755,9 @@ int stackGetParams(const char *params, ...)
 	va_start(args, params);
 
 	int errors = 0;
+	size_t len = strlen(params);
 
-	for (size_t i = 0; i < strlen(params); i++)
+	for (size_t i = 0; i < len; i++)
 	{
 		switch (params[i])
 		{
@@ -497,14 +830,8 @@ int stackGetParams(const char *params, ...)
 	return errors == 0; // success if no errors
 }
 
-int stackGetParamInt(int param, int *value)
+int stackGetArg(VariableValue *var, int *value)
 {
-	if (param >= Scr_GetNumParam())
-		return 0;
-
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
-
 	if (var->type == STACK_FLOAT)
 	{
 		*value = var->u.floatValue;
@@ -519,23 +846,63 @@ int stackGetParamInt(int param, int *value)
 	return 1;
 }
 
-int stackGetParamFunction(int param, int *value)
+int stackGetArg(VariableValue *var, float *value)
 {
-	if (param >= Scr_GetNumParam())
+	if (var->type == STACK_INT)
+	{
+		*value = var->u.intValue;
+		return 1;
+	}
+
+	if (var->type != STACK_FLOAT)
 		return 0;
 
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
+	*value = var->u.floatValue;
 
-	if (var->type != STACK_FUNCTION)
+	return 1;
+}
+
+int stackGetArg(VariableValue *var, char **value)
+{
+	if (var->type != STACK_STRING)
 		return 0;
 
-	*value = var->u.codePosValue - scrVarPub.programBuffer;
+	*value = SL_ConvertToString(var->u.stringValue);
 
 	return 1;
 }
 
-int stackGetParamString(int param, char **value)
+int stackGetArg(VariableValue *var, vec3_t *value)
+{
+	if (var->type != STACK_VECTOR)
+		return 0;
+
+	(*value)[0] = var->u.vectorValue[0];
+	(*value)[1] = var->u.vectorValue[1];
+	(*value)[2] = var->u.vectorValue[2];
+
+	return 1;
+}
+
+int stackGetArg(VariableValue *var, unsigned int *value)
+{
+	if (var->type != STACK_OBJECT)
+		return 0;
+
+	*value = var->u.pointerValue;
+
+	return 1;
+}
+
+int stackGetParamInt(int param, int *value)
+{
+	if (param >= Scr_GetNumParam())
+		return 0;
+
+	return stackGetArg(&scrVmPub.top[-param], value);
+}
+
+int stackGetParamFunction(int param, int *value)
 {
 	if (param >= Scr_GetNumParam())
 		return 0;
@@ -543,14 +910,22 @@ int stackGetParamString(int param, char **value)
 	VariableValue *var;
 	var = &scrVmPub.top[-param];
 
-	if (var->type != STACK_STRING)
+	if (var->type != STACK_FUNCTION)
 		return 0;
 
-	*value = SL_ConvertToString(var->u.stringValue);
+	*value = var->u.codePosValue - scrVarPub.programBuffer;
 
 	return 1;
 }
 
+int stackGetParamString(int param, char **value)
+{
+	if (param >= Scr_GetNumParam())
+		return 0;
+
+	return stackGetArg(&scrVmPub.top[-param], value);
+}
+
 int stackGetParamConstString(int param, unsigned int *value)
 {
 	if (param >= Scr_GetNumParam())
@@ -572,53 +947,307 @@ int stackGetParamVector(int param, vec3_t value)
 	if (param >= Scr_GetNumParam())
 		return 0;
 
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
+	return stackGetArg(&scrVmPub.top[-param], (vec3_t *)value);
+}
 
-	if (var->type != STACK_VECTOR)
+int stackGetParamFloat(int param, float *value)
+{
+	if (param >= Scr_GetNumParam())
 		return 0;
 
-	value[0] = *(float *)(var->u.vectorValue + 0);
-	value[1] = *(float *)(var->u.vectorValue + 1);
-	value[2] = *(float *)(var->u.vectorValue + 2);
-
-	return 1;
+	return stackGetArg(&scrVmPub.top[-param], value);
 }
 
-int stackGetParamFloat(int param, float *value)
+int stackGetParamObject(int param, unsigned int *value)
 {
 	if (param >= Scr_GetNumParam())
 		return 0;
 
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
+	return stackGetArg(&scrVmPub.top[-param], value);
+}
 
-	if (var->type == STACK_INT)
+static int stackSaveString(const char *str, stackSavedValue_t *value, char *arena, int used)
+{
+	int len = strlen(str);
+
+	value->type = STACK_STRING;
+
+	if (len < SAVED_INLINE_STRING)
 	{
-		*value = var->u.intValue;
-		return 1;
+		value->inlined = 1;
+		memcpy(value->u.string, str, len + 1);
+		return 0;
 	}
 
-	if (var->type != STACK_FLOAT)
-		return 0;
+	value->inlined = 0;
+	value->u.offset = used;
 
-	*value = var->u.floatValue;
+	if (arena != NULL)
+		memcpy(arena + used, str, len + 1);
 
-	return 1;
+	return (len + 4) & ~3; // keep the arena aligned for copied arrays
 }
 
-int stackGetParamObject(int param, unsigned int *value)
+static int stackSavePrimitive(int type, union VariableUnion *u, stackSavedValue_t *value, char *arena, int used)
 {
-	if (param >= Scr_GetNumParam())
+	memset(value, 0, sizeof(stackSavedValue_t));
+
+	switch (type)
+	{
+	case STACK_INT:
+		value->type = STACK_INT;
+		value->u.intValue = u->intValue;
 		return 0;
 
-	VariableValue *var;
-	var = &scrVmPub.top[-param];
+	case STACK_FLOAT:
+		value->type = STACK_FLOAT;
+		value->u.floatValue = u->floatValue;
+		return 0;
+
+	case STACK_STRING:
+		return stackSaveString(SL_ConvertToString(u->stringValue), value, arena, used);
+
+	case STACK_VECTOR:
+		value->type = STACK_VECTOR;
+		value->u.vectorValue[0] = u->vectorValue[0];
+		value->u.vectorValue[1] = u->vectorValue[1];
+		value->u.vectorValue[2] = u->vectorValue[2];
+		return 0;
 
+	default:
+		value->type = STACK_UNDEFINED;
+		return 0;
+	}
+}
+
+static int stackSaveArray(unsigned int arrIndex, stackSavedValue_t *value, char *arena, int used)
+{
+	int size = GetArraySize(arrIndex);
+
+	if (size > MAX_SAVED_ARRAY_SIZE)
+		size = MAX_SAVED_ARRAY_SIZE;
+
+	value->type = STACK_ARRAY;
+	value->count = size;
+	value->u.offset = used;
+
+	stackSavedValue_t scratch;
+	stackSavedValue_t *elements = (arena != NULL) ? (stackSavedValue_t *)(arena + used) : NULL;
+	int bytes = size * sizeof(stackSavedValue_t);
+	unsigned int index = arrIndex;
+
+	// only primitive elements are copied, nested arrays and objects become undefined
+	for (int i = 0; i < size; i++)
+	{
+		index = GetNextVariable(index);
+		VariableValueInternal *entry = &scrVarGlob_high[index];
+		bytes += stackSavePrimitive(entry->w.type & 0x1F, &entry->u.u, (elements != NULL) ? &elements[i] : &scratch, arena, used + bytes);
+	}
+
+	return bytes;
+}
+
+static int stackSaveValue(VariableValue *var, stackSavedValue_t *value, char *arena, int used)
+{
 	if (var->type != STACK_OBJECT)
+		return stackSavePrimitive(var->type, &var->u, value, arena, used);
+
+	memset(value, 0, sizeof(stackSavedValue_t));
+
+	if ((scrVarGlob[var->u.pointerValue].w.type & 0x1F) == STACK_ARRAY)
+		return stackSaveArray(var->u.pointerValue, value, arena, used);
+
+	value->type = STACK_OBJECT;
+	value->u.objectValue = var->u.pointerValue;
+
+	return 0;
+}
+
+int stackSaveArgs(int first, stackSavedArgs_t *args)
+{
+	args->count = 0;
+	args->values = NULL;
+
+	int num = Scr_GetNumParam() - first;
+
+	if (num > MAX_SAVED_ARGS)
+		num = MAX_SAVED_ARGS;
+
+	VariableValue *top = scrVmPub.top;
+
+	// trailing undefined arguments are not passed to the callback
+	while (num > 0 && top[-(first + num - 1)].type == STACK_UNDEFINED)
+		num--;
+
+	if (num <= 0)
 		return 0;
 
-	*value = var->u.pointerValue;
+	// first pass measures the arena, second pass fills one allocation
+	stackSavedValue_t scratch;
+	int bytes = 0;
 
-	return 1;
+	for (int i = 0; i < num; i++)
+		bytes += stackSaveValue(&top[-(first + i)], &scratch, NULL, bytes);
+
+	char *block = (char *)malloc(num * sizeof(stackSavedValue_t) + bytes);
+
+	if (block == NULL)
+		return 0;
+
+	stackSavedValue_t *values = (stackSavedValue_t *)block;
+	char *arena = block + num * sizeof(stackSavedValue_t);
+
+	bytes = 0;
+
+	for (int i = 0; i < num; i++)
+		bytes += stackSaveValue(&top[-(first + i)], &values[i], arena, bytes);
+
+	args->count = num;
+	args->values = values;
+
+	return num;
 }
+
+static void stackPushSavedValue(stackSavedValue_t *value, char *arena)
+{
+	switch (value->type)
+	{
+	case STACK_INT:
+		stackPushInt(value->u.intValue);
+		break;
+
+	case STACK_FLOAT:
+		stackPushFloat(value->u.floatValue);
+		break;
+
+	case STACK_STRING:
+		stackPushString(value->inlined ? value->u.string : arena + value->u.offset);
+		break;
+
+	case STACK_VECTOR:
+		stackPushVector(value->u.vectorValue);
+		break;
+
+	case STACK_OBJECT:
+		stackPushObject(value->u.objectValue);
+		break;
+
+	case STACK_ARRAY:
+	{
+		stackSavedValue_t *elements = (stackSavedValue_t *)(arena + value->u.offset);
+
+		stackPushArray();
+
+		// array children are linked newest first, rebuild them in insertion order
+		for (int i = value->count - 1; i >= 0; i--)
+		{
+			stackPushSavedValue(&elements[i], arena);
+			stackPushArrayLast();
+		}
+
+		break;
+	}
+
+	default:
+		stackPushUndefined();
+		break;
+	}
+}
+
+int stackPushSavedArgs(stackSavedArgs_t *args)
+{
+	if (args->values == NULL)
+		return 0;
+
+	char *arena = (char *)(args->values + args->count);
+
+	// pushed last to first, so the first saved argument follows the pushed result
+	for (int i = args->count - 1; i >= 0; i--)
+		stackPushSavedValue(&args->values[i], arena);
+
+	return args->count;
+}
+
+void stackFreeSavedArgs(stackSavedArgs_t *args)
+{
+	if (args->values != NULL)
+		free(args->values);
+
+	args->count = 0;
+	args->values = NULL;
+}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+int await_free_handles[MAX_AWAIT_HANDLES];
+int await_free_count = 0;
+int await_live_count = 0; // spawned on this level, pending or parked in the free list
+unsigned int await_levelId = 0;
+unsigned int await_classname = 0;
+
+static void await_handle_refresh()
+{
+	if (await_classname && await_levelId == scrVarPub.levelId)
+		return;
+
+	// entities of the previous level are gone, start over with an empty pool
+	await_free_count = 0;
+	await_live_count = 0;
+	await_levelId = scrVarPub.levelId;
+	await_classname = SL_GetString("libcod_await", 0);
+}
+
+int await_handle_spawn()
+{
+	await_handle_refresh();
+
+	while (await_free_count > 0)
+	{
+		int handle = await_free_handles[--await_free_count];
+
+		if (await_handle_valid(handle, scrVarPub.levelId))
+			return handle;
+	}
+
+	// handles deleted by scripts still count until a recount finds them gone
+	if (await_live_count >= MAX_AWAIT_HANDLES)
+	{
+		await_live_count = 0;
+
+		for (int i = 0; i < MAX_GENTITIES; i++)
+		{
+			if (g_entities[i].r.inuse && g_entities[i].classname == await_classname)
+				await_live_count++;
+		}
+
+		if (await_live_count >= MAX_AWAIT_HANDLES)
+			return -1;
+	}
+
+	gentity_t *ent = G_Spawn();
+	ent->classname = await_classname;
+	await_live_count++;
+
+	return ent->s.number;
+}
+
+int await_handle_valid(int handle, unsigned int levelId)
+{
+	if (handle < 0 || !Scr_IsSystemActive() || levelId != scrVarPub.levelId)
+		return 0;
+
+	await_handle_refresh();
+
+	gentity_t *ent = &g_entities[handle];
+
+	// the script deleted the handle, the slot may belong to something else now
+	return ent->r.inuse && ent->classname == await_classname;
+}
+
+void await_handle_notify(int handle, unsigned int numArgs)
+{
+	Scr_NotifyNum(handle, 0, scr_const.done, numArgs);
+
+	if (await_free_count < MAX_AWAIT_HANDLES)
+		await_free_handles[await_free_count++] = handle;
+}
+#endif
@@ -25,6 +25,8 @@
 #include <sys/stat.h> // fsize
 #include <time.h>  // getsystemtime
 #include <ctype.h> // isdigit
+#include <fcntl.h> // open
+#include <sys/inotify.h> // manymaps library index
 
 #include "config.hpp"
 #include "declarations.hpp"
@@ -125,6 +127,114 @@ int stackGetParamVector(int param, vec3_t value);
 int stackGetParamFloat(int param, float *value);
 int stackGetParamObject(int param, unsigned int *value);
 
+/* typed arguments, stackGetArgs("gsc_foo", &id, &name) raises a script error naming the bad argument */
+const char *stackGetTypeName(int type);
+
+int stackGetArg(VariableValue *var, int *value);
+int stackGetArg(VariableValue *var, float *value);
+int stackGetArg(VariableValue *var, char **value);
+int stackGetArg(VariableValue *var, vec3_t *value);
+int stackGetArg(VariableValue *var, unsigned int *value); // object
+
+inline const char *stackGetArgTypeName(int *) { return "INT"; }
+inline const char *stackGetArgTypeName(float *) { return "FLOAT"; }
+inline const char *stackGetArgTypeName(char **) { return "STRING"; }
+inline const char *stackGetArgTypeName(vec3_t *) { return "VECTOR"; }
+inline const char *stackGetArgTypeName(unsigned int *) { return "OBJECT"; }
+
+inline int stackGetArgsAt(const char *func, VariableValue *top, int num, int index, int required)
+{
+	return 1;
+}
+
+template <typename T, typename... Rest>
+int stackGetArgsAt(const char *func, VariableValue *top, int num, int index, int required, T *value, Rest... rest)
+{
+	VariableValue *var = &top[-index];
+
+	// optional arguments that were not passed keep the value set by the caller
+	if (index >= num)
+	{
+		if (index < required)
+		{
+			stackError("%s() argument %d is missing, expected %s", func, index + 1, stackGetArgTypeName(value));
+			return 0;
+		}
+
+		return 1;
+	}
+
+	// an undefined optional argument only skips its own slot, later ones are still read
+	if (index >= required && var->type == STACK_UNDEFINED)
+		return stackGetArgsAt(func, top, num, index + 1, required, rest...);
+
+	if (!stackGetArg(var, value))
+	{
+		stackError("%s() argument %d has a wrong type, expected %s but got %s", func, index + 1, stackGetArgTypeName(value), stackGetTypeName(var->type));
+		return 0;
+	}
+
+	return stackGetArgsAt(func, top, num, index + 1, required, rest...);
+}
+
+template <typename... Args>
+int stackGetArgs(const char *func, Args... args)
+{
+	return stackGetArgsAt(func, scrVmPub.top, Scr_GetNumParam(), 0, sizeof...(Args), args...);
+}
+
+template <typename... Args>
+int stackGetArgsOpt(const char *func, int required, Args... args)
+{
+	return stackGetArgsAt(func, scrVmPub.top, Scr_GetNumParam(), 0, required, args...);
+}
+
+/* saved arguments, used to pass script values to deferred callbacks */
+#define MAX_SAVED_ARGS 8
+#define MAX_SAVED_ARRAY_SIZE 256
+#define SAVED_INLINE_STRING 12
+
+typedef struct
+{
+	byte type; // STACK_UNDEFINED, STACK_INT, STACK_FLOAT, STACK_STRING, STACK_VECTOR, STACK_OBJECT or STACK_ARRAY
+	byte inlined; // string is stored in u.string instead of the arena
+	u_int16_t count; // elements of a copied array
+	union
+	{
+		int intValue;
+		float floatValue;
+		float vectorValue[3];
+		unsigned int objectValue;
+		int offset; // long string or array elements, relative to the arena
+		char string[SAVED_INLINE_STRING];
+	} u;
+} stackSavedValue_t;
+
+typedef struct
+{
+	int count;
+	stackSavedValue_t *values; // one allocation: values[count] followed by the arena
+} stackSavedArgs_t;
+
+int stackSaveArgs(int first, stackSavedArgs_t *args);
+int stackPushSavedArgs(stackSavedArgs_t *args);
+void stackFreeSavedArgs(stackSavedArgs_t *args);
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+/* await handles, hidden entities notified with "done" when a deferred task completes */
+#define MAX_AWAIT_HANDLES 128 // live handles per level, kept well below the entity limit
+
+int await_handle_spawn(); // -1 when MAX_AWAIT_HANDLES are alive
+int await_handle_valid(int handle, unsigned int levelId);
+void await_handle_notify(int handle, unsigned int numArgs);
+#endif
+
+void Scr_InitCustomFunctions();
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void Scr_ProfileCommand();
+void gsc_scriptprofile_dump();
+void gsc_scriptprofile_reset();
+#endif
 xfunction_t Scr_GetCustomFunction(const char **fname, qboolean *fdev);
 xmethod_t Scr_GetCustomMethod(const char **fname, qboolean *fdev);
 
@@ -4,15 +4,6 @@
 
 #include <pthread.h>
 
-enum
-{
-	INT_VALUE,
-	FLOAT_VALUE,
-	STRING_VALUE,
-	VECTOR_VALUE,
-	OBJECT_VALUE
-};
-
 struct exec_outputline
 {
 	char content[MAX_STRINGLENGTH];
@@ -30,13 +21,8 @@ struct exec_async_task
 	bool error;
 	exec_outputline *output;
 	unsigned int levelId;
-	bool hasargument;
-	int valueType;
-	int intValue;
-	float floatValue;
-	char stringValue[MAX_STRINGLENGTH];
-	vec3_t vectorValue;
-	unsigned int objectValue;
+	stackSavedArgs_t args;
+	int handle;
 };
 
 exec_async_task *first_exec_async_task = NULL;
@@ -104,6 +90,7 @@ void *exec_async(void *input_c)
 	if (fp == NULL)
 	{
 		task->error = true;
+		task->done = true;
 		return NULL;
 	}
 
@@ -179,43 +166,9 @@ void gsc_exec_async_create()
 	newtask->save = true;
 	newtask->error = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
-
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
+	newtask->handle = -1;
 
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(2, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(2, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(2, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(2, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -277,43 +230,77 @@ void gsc_exec_async_create_nosave()
 	newtask->save = false;
 	newtask->error = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
+	stackSaveArgs(2, &newtask->args);
 
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
+	if (current != NULL)
+		current->next = newtask;
+	else
+		first_exec_async_task = newtask;
+
+	pthread_t exec_doer;
+
+	if (pthread_create(&exec_doer, NULL, exec_async, newtask) != 0)
 	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
+		stackError("gsc_exec_async_create_nosave() error creating exec async handler thread!");
+		stackPushUndefined();
+		return;
 	}
-	else if (stackGetParamString(2, &valueString))
+
+	if (pthread_detach(exec_doer) != 0)
 	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
+		stackError("gsc_exec_async_create_nosave() error detaching exec async handler thread!");
+		stackPushUndefined();
+		return;
 	}
-	else if (stackGetParamVector(2, valueVector))
+
+	stackPushInt(1);
+}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_exec_async_create_await()
+{
+	char *command;
+
+	if (!stackGetParamString(0, &command))
 	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
+		stackError("gsc_exec_async_create_await() argument is undefined or has wrong type");
+		stackPushUndefined();
+		return;
 	}
-	else if (stackGetParamObject(2, &valueObject))
+
+	int handle = await_handle_spawn();
+
+	if (handle < 0)
 	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
+		stackError("gsc_exec_async_create_await() too many awaits are pending");
+		stackPushUndefined();
+		return;
 	}
-	else
-		newtask->hasargument = false;
+
+	Com_DPrintf("gsc_exec_async_create_await() executing: %s\n", command);
+
+	exec_async_task *current = first_exec_async_task;
+
+	while (current != NULL && current->next != NULL)
+		current = current->next;
+
+	exec_async_task *newtask = new exec_async_task;
+
+	strncpy(newtask->command, command, MAX_STRINGLENGTH - 1);
+	newtask->command[MAX_STRINGLENGTH - 1] = '\0';
+	newtask->output = NULL;
+	newtask->prev = current;
+	newtask->next = NULL;
+	newtask->callback = 0;
+	newtask->done = false;
+	newtask->save = true;
+	newtask->error = false;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->args.count = 0;
+	newtask->args.values = NULL;
+	newtask->handle = handle;
 
 	if (current != NULL)
 		current->next = newtask;
@@ -324,22 +311,23 @@ void gsc_exec_async_create_nosave()
 
 	if (pthread_create(&exec_doer, NULL, exec_async, newtask) != 0)
 	{
-		stackError("gsc_exec_async_create_nosave() error creating exec async handler thread!");
+		stackError("gsc_exec_async_create_await() error creating exec async handler thread!");
 		stackPushUndefined();
 		return;
 	}
 
 	if (pthread_detach(exec_doer) != 0)
 	{
-		stackError("gsc_exec_async_create_nosave() error detaching exec async handler thread!");
+		stackError("gsc_exec_async_create_await() error detaching exec async handler thread!");
 		stackPushUndefined();
 		return;
 	}
 
-	stackPushInt(1);
+	stackPushEntity(&g_entities[newtask->handle]);
 }
+#endif
 
-void gsc_exec_async_checkdone()
+void exec_async_deliver()
 {
 	exec_async_task *current = first_exec_async_task;
 
@@ -350,55 +338,58 @@ void gsc_exec_async_checkdone()
 
 		if (task->done)
 		{
-			//push to cod
-			if (Scr_IsSystemActive() && task->save && task->callback && !task->error && (scrVarPub.levelId == task->levelId))
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+			if (task->handle >= 0)
 			{
-				if (task->hasargument)
+				//wake the waiting script thread
+				if (await_handle_valid(task->handle, task->levelId))
 				{
-					switch(task->valueType)
+					if (!task->error)
 					{
-					case INT_VALUE:
-						stackPushInt(task->intValue);
-						break;
-
-					case FLOAT_VALUE:
-						stackPushFloat(task->floatValue);
-						break;
-
-					case STRING_VALUE:
-						stackPushString(task->stringValue);
-						break;
-
-					case VECTOR_VALUE:
-						stackPushVector(task->vectorValue);
-						break;
-
-					case OBJECT_VALUE:
-						stackPushObject(task->objectValue);
-						break;
+						stackPushArray();
 
-					default:
-						stackPushUndefined();
-						break;
+						for (exec_outputline *output = task->output; output != NULL; output = output->next)
+						{
+							stackPushString(output->content);
+							stackPushArrayLast();
+						}
 					}
+					else
+						stackPushUndefined();
+
+					await_handle_notify(task->handle, 1);
 				}
+			}
+			else
+#endif
+			//push to cod
+			if (Scr_IsSystemActive() && task->save && task->callback && !task->error && (scrVarPub.levelId == task->levelId))
+			{
+				stackPushSavedArgs(&task->args);
 
 				stackPushArray();
-				exec_outputline *output = task->output;
 
-				while (output != NULL)
+				for (exec_outputline *output = task->output; output != NULL; output = output->next)
 				{
-					exec_outputline *next = output->next;
 					stackPushString(output->content);
 					stackPushArrayLast();
-					delete output;
-					output = next;
 				}
 
-				short ret = Scr_ExecThread(task->callback, task->save + task->hasargument);
+				short ret = Scr_ExecThread(task->callback, task->save + task->args.count);
 				Scr_FreeThread(ret);
 			}
 
+			exec_outputline *output = task->output;
+
+			while (output != NULL)
+			{
+				exec_outputline *next = output->next;
+				delete output;
+				output = next;
+			}
+
+			stackFreeSavedArgs(&task->args);
+
 			//free task
 			if (task->next != NULL)
 				task->next->prev = task->prev;
@@ -413,4 +404,24 @@ void gsc_exec_async_checkdone()
 	}
 }
 
+void gsc_exec_async_checkdone()
+{
+	// results are delivered every server frame, kept for older scripts
+	exec_async_deliver();
+}
+
+// Tasks still running, for the metrics endpoint
+int exec_async_pending()
+{
+	int pending = 0;
+
+	for (exec_async_task *task = first_exec_async_task; task != NULL; task = task->next)
+	{
+		if (!task->done)
+			pending++;
+	}
+
+	return pending;
+}
+
 #endif
@@ -9,4 +9,11 @@ void gsc_exec_async_create();
 void gsc_exec_async_create_nosave();
 void gsc_exec_async_checkdone();
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_exec_async_create_await();
+#endif
+
+void exec_async_deliver();
+int exec_async_pending();
+
 #endif
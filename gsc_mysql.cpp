@@ -15,6 +15,8 @@ struct mysql_async_task
 	bool started;
 	bool save;
 	char query[MAX_STRINGLENGTH + 1];
+	unsigned int levelId;
+	int handle;
 };
 
 struct mysql_async_connection
@@ -99,7 +101,7 @@ void *mysql_async_query_handler(void* input_nothing) //is threaded after initial
 	return NULL;
 }
 
-int mysql_async_query_initializer(char *sql, bool save) //cannot be called from gsc, helper function
+int mysql_async_query_initializer(char *sql, bool save, int handle) //cannot be called from gsc, helper function
 {
 	static int id = 0;
 	id++;
@@ -116,6 +118,8 @@ int mysql_async_query_initializer(char *sql, bool save) //cannot be called from
 	newtask->done = false;
 	newtask->next = NULL;
 	newtask->started = false;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = handle;
 	if(current != NULL)
 		current->next = newtask;
 	else
@@ -133,7 +137,7 @@ void gsc_mysql_async_create_query_nosave()
 		stackPushUndefined();
 		return;
 	}
-	int id = mysql_async_query_initializer(query, false);
+	int id = mysql_async_query_initializer(query, false, -1);
 	stackPushInt(id);
 	return;
 }
@@ -147,11 +151,73 @@ void gsc_mysql_async_create_query()
 		stackPushUndefined();
 		return;
 	}
-	int id = mysql_async_query_initializer(query, true);
+	int id = mysql_async_query_initializer(query, true, -1);
 	stackPushInt(id);
 	return;
 }
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_mysql_async_create_query_await()
+{
+	char *query;
+	if ( ! stackGetParams("s", &query))
+	{
+		stackError("gsc_mysql_async_create_query_await() argument is undefined or has a wrong type");
+		stackPushUndefined();
+		return;
+	}
+	int handle = await_handle_spawn();
+
+	if (handle < 0)
+	{
+		stackError("gsc_mysql_async_create_query_await() too many awaits are pending");
+		stackPushUndefined();
+		return;
+	}
+
+	mysql_async_query_initializer(query, true, handle);
+	stackPushEntity(&g_entities[handle]);
+	return;
+}
+
+void mysql_async_deliver() //wakes await handles, results are passed like mysql_async_getresult_and_free
+{
+	mysql_async_task *done = NULL;
+	pthread_mutex_lock(&lock_async_mysql);
+	mysql_async_task *c = first_async_task;
+	while(c != NULL)
+	{
+		mysql_async_task *next = c->next;
+		if(c->done && c->handle >= 0)
+		{
+			if(c->next != NULL)
+				c->next->prev = c->prev;
+			if(c->prev != NULL)
+				c->prev->next = c->next;
+			else
+				first_async_task = c->next;
+			c->next = done;
+			done = c;
+		}
+		c = next;
+	}
+	pthread_mutex_unlock(&lock_async_mysql);
+	while(done != NULL) //notify outside of the lock, scripts may queue new queries
+	{
+		c = done;
+		done = done->next;
+		if(await_handle_valid(c->handle, c->levelId))
+		{
+			stackPushInt((int)c->result);
+			await_handle_notify(c->handle, 1);
+		}
+		else if(c->result != NULL)
+			mysql_free_result(c->result);
+		delete c;
+	}
+}
+#endif
+
 void gsc_mysql_async_getdone_list()
 {
 	pthread_mutex_lock(&lock_async_mysql);
@@ -159,7 +225,7 @@ void gsc_mysql_async_getdone_list()
 	stackPushArray();
 	while(current != NULL)
 	{
-		if(current->done)
+		if(current->done && current->handle < 0)
 		{
 			stackPushInt((int)current->id);
 			stackPushArrayLast();
@@ -553,4 +619,23 @@ void gsc_mysql_real_escape_string()
 	free(to);
 }
 
+// Queries not finished yet, -1 when the queue is locked by the query thread
+int mysql_async_pending()
+{
+	if (pthread_mutex_trylock(&lock_async_mysql) != 0)
+		return -1;
+
+	int pending = 0;
+
+	for (mysql_async_task *task = first_async_task; task != NULL; task = task->next)
+	{
+		if (!task->done)
+			pending++;
+	}
+
+	pthread_mutex_unlock(&lock_async_mysql);
+
+	return pending;
+}
+
 #endif
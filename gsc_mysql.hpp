@@ -25,5 +25,11 @@ void gsc_mysql_async_getdone_list();
 void gsc_mysql_async_getresult_and_free();
 void gsc_mysql_async_initializer();
 void gsc_mysql_reuse_connection();
+int mysql_async_pending();
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_mysql_async_create_query_await();
+void mysql_async_deliver();
+#endif
 
 #endif
@@ -5,15 +5,6 @@
 #include <mysql/mysql.h>
 #include <pthread.h>
 
-enum
-{
-	INT_VALUE,
-	FLOAT_VALUE,
-	STRING_VALUE,
-	VECTOR_VALUE,
-	OBJECT_VALUE
-};
-
 struct async_mysql_task
 {
 	async_mysql_task *prev;
@@ -27,15 +18,11 @@ struct async_mysql_task
 	bool cleanup;
 	MYSQL_RES *result;
 	unsigned int levelId;
-	bool hasargument;
-	int valueType;
-	int intValue;
-	float floatValue;
-	char stringValue[MAX_STRINGLENGTH];
-	vec3_t vectorValue;
-	unsigned int objectValue;
+	stackSavedArgs_t args;
 	bool hasentity;
 	gentity_t *gentity;
+	bool error;
+	int handle;
 };
 
 MYSQL *async_mysql_connection = NULL;
@@ -78,8 +65,14 @@ void *async_mysql_query_handler(void* dummy)
 					task->result = mysql_store_result(async_mysql_connection);
 				else
 				{
-					task->complete = true;
-					task->cleanup = true;
+					task->error = true;
+
+					// await handles still have to be woken up with the failure
+					if (task->handle < 0)
+					{
+						task->complete = true;
+						task->cleanup = true;
+					}
 				}
 
 				task->done = true;
@@ -100,6 +93,8 @@ void *async_mysql_query_handler(void* dummy)
 				if (task->result != NULL)
 					mysql_free_result(task->result);
 
+				stackFreeSavedArgs(&task->args);
+
 				delete task;
 
 				pthread_mutex_unlock(&lock_async_mysql);
@@ -225,45 +220,12 @@ void gsc_async_mysql_create_query()
 	newtask->save = true;
 	newtask->cleanup = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
 	newtask->hasentity = false;
 	newtask->gentity = NULL;
+	newtask->error = false;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(2, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(2, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(2, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(2, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -321,45 +283,12 @@ void gsc_async_mysql_create_query_nosave()
 	newtask->save = false;
 	newtask->cleanup = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
 	newtask->hasentity = false;
 	newtask->gentity = NULL;
+	newtask->error = false;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(2, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(2, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(2, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(2, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -417,45 +346,12 @@ void gsc_async_mysql_create_entity_query(scr_entref_t entid)
 	newtask->save = true;
 	newtask->cleanup = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
 	newtask->hasentity = true;
 	newtask->gentity = &g_entities[entid];
+	newtask->error = false;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(2, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(2, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(2, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(2, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -513,45 +409,78 @@ void gsc_async_mysql_create_entity_query_nosave(scr_entref_t entid)
 	newtask->save = false;
 	newtask->cleanup = false;
 	newtask->levelId = scrVarPub.levelId;
-	newtask->hasargument = true;
 	newtask->hasentity = true;
 	newtask->gentity = &g_entities[entid];
+	newtask->error = false;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
+	stackSaveArgs(2, &newtask->args);
 
-	if (stackGetParamInt(2, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(2, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(2, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(2, valueVector))
+	if (current != NULL)
+		current->next = newtask;
+	else
+		first_async_mysql_task = newtask;
+
+	pthread_mutex_unlock(&lock_async_mysql);
+
+	stackPushBool(qtrue);
+}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_async_mysql_create_query_await()
+{
+	char *query;
+
+	if ( ! stackGetParams("s", &query))
 	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
+		stackError("gsc_async_mysql_create_query_await() argument is undefined or has a wrong type");
+		stackPushUndefined();
+		return;
 	}
-	else if (stackGetParamObject(2, &valueObject))
+
+	int handle = await_handle_spawn();
+
+	if (handle < 0)
 	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
+		stackError("gsc_async_mysql_create_query_await() too many awaits are pending");
+		stackPushUndefined();
+		return;
 	}
+
+	pthread_mutex_lock(&lock_async_mysql);
+
+	async_mysql_task *current = first_async_mysql_task;
+
+	while (current != NULL && current->next != NULL)
+		current = current->next;
+
+	async_mysql_task *newtask = new async_mysql_task;
+
+	newtask->id = async_task_id;
+
+	if (async_task_id == 2147483647)
+		async_task_id = 0;
 	else
-		newtask->hasargument = false;
+		async_task_id++;
+
+	strncpy(newtask->query, query, MAX_STRINGLENGTH - 1);
+	newtask->query[MAX_STRINGLENGTH - 1] = '\0';
+
+	newtask->prev = current;
+	newtask->next = NULL;
+	newtask->callback = 0;
+	newtask->result = NULL;
+	newtask->done = false;
+	newtask->complete = false;
+	newtask->save = true;
+	newtask->cleanup = false;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->hasentity = false;
+	newtask->gentity = NULL;
+	newtask->error = false;
+	newtask->handle = handle;
+	newtask->args.count = 0;
+	newtask->args.values = NULL;
 
 	if (current != NULL)
 		current->next = newtask;
@@ -560,10 +489,11 @@ void gsc_async_mysql_create_entity_query_nosave(scr_entref_t entid)
 
 	pthread_mutex_unlock(&lock_async_mysql);
 
-	stackPushBool(qtrue);
+	stackPushEntity(&g_entities[newtask->handle]);
 }
+#endif
 
-void gsc_async_mysql_checkdone()
+void mysql_async_deliver()
 {
 	async_mysql_task *current = first_async_mysql_task;
 
@@ -576,45 +506,39 @@ void gsc_async_mysql_checkdone()
 		{
 			task->complete = true;
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+			if (task->handle >= 0)
+			{
+				//wake the waiting script thread, it frees the task by id
+				bool cleanup = task->error;
+
+				if (await_handle_valid(task->handle, task->levelId))
+				{
+					if (!task->error)
+						stackPushInt(task->id);
+					else
+						stackPushUndefined();
+
+					await_handle_notify(task->handle, 1);
+				}
+				else
+					cleanup = true;
+
+				task->cleanup = cleanup;
+			}
+			else
+#endif
 			if (Scr_IsSystemActive() && task->save && task->callback && (scrVarPub.levelId == task->levelId))
 			{
 				if (task->hasentity)
 				{
 					if (task->gentity != NULL)
 					{
-						if (task->hasargument)
-						{
-							switch(task->valueType)
-							{
-							case INT_VALUE:
-								stackPushInt(task->intValue);
-								break;
-
-							case FLOAT_VALUE:
-								stackPushFloat(task->floatValue);
-								break;
-
-							case STRING_VALUE:
-								stackPushString(task->stringValue);
-								break;
-
-							case VECTOR_VALUE:
-								stackPushVector(task->vectorValue);
-								break;
-
-							case OBJECT_VALUE:
-								stackPushObject(task->objectValue);
-								break;
-
-							default:
-								stackPushUndefined();
-								break;
-							}
-						}
+						stackPushSavedArgs(&task->args);
 
 						stackPushInt(task->id);
 
-						short ret = Scr_ExecEntThread(task->gentity, task->callback, task->save + task->hasargument);
+						short ret = Scr_ExecEntThread(task->gentity, task->callback, task->save + task->args.count);
 						Scr_FreeThread(ret);
 					}
 					else
@@ -622,35 +546,11 @@ void gsc_async_mysql_checkdone()
 				}
 				else
 				{
-					if (task->hasargument)
-					{
-						switch(task->valueType)
-						{
-						case INT_VALUE:
-							stackPushInt(task->intValue);
-							break;
-
-						case FLOAT_VALUE:
-							stackPushFloat(task->floatValue);
-							break;
-
-						case STRING_VALUE:
-							stackPushString(task->stringValue);
-							break;
-
-						case VECTOR_VALUE:
-							stackPushVector(task->vectorValue);
-							break;
-
-						default:
-							stackPushUndefined();
-							break;
-						}
-					}
+					stackPushSavedArgs(&task->args);
 
 					stackPushInt(task->id);
 
-					short ret = Scr_ExecThread(task->callback, task->save + task->hasargument);
+					short ret = Scr_ExecThread(task->callback, task->save + task->args.count);
 					Scr_FreeThread(ret);
 				}
 			}
@@ -660,6 +560,12 @@ void gsc_async_mysql_checkdone()
 	}
 }
 
+void gsc_async_mysql_checkdone()
+{
+	// results are delivered every server frame, kept for older scripts
+	mysql_async_deliver();
+}
+
 void gsc_async_mysql_errno()
 {
 	if (async_mysql_connection == NULL)
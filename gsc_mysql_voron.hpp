@@ -38,4 +38,10 @@ void gsc_async_mysql_real_escape_string();
 void gsc_async_mysql_create_entity_query(scr_entref_t entid);
 void gsc_async_mysql_create_entity_query_nosave(scr_entref_t entid);
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_async_mysql_create_query_await();
+#endif
+
+void mysql_async_deliver();
+
 #endif
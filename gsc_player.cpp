@@ -6,9 +6,8 @@ void gsc_player_velocity_set(scr_entref_t id)
 {
 	vec3_t velocity;
 
-	if ( ! stackGetParams("v", &velocity))
+	if ( ! stackGetArgs("gsc_player_velocity_set", &velocity))
 	{
-		stackError("gsc_player_velocity_set() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -30,9 +29,8 @@ void gsc_player_velocity_add(scr_entref_t id)
 {
 	vec3_t velocity;
 
-	if ( ! stackGetParams("v", &velocity))
+	if ( ! stackGetArgs("gsc_player_velocity_add", &velocity))
 	{
-		stackError("gsc_player_velocity_add() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -74,9 +72,8 @@ void gsc_player_get_userinfo(scr_entref_t id)
 {
 	char *key;
 
-	if ( ! stackGetParams("s", &key))
+	if ( ! stackGetArgs("gsc_player_get_userinfo", &key))
 	{
-		stackError("gsc_player_get_userinfo() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -102,9 +99,8 @@ void gsc_player_set_userinfo(scr_entref_t id)
 {
 	char *key, *value;
 
-	if ( ! stackGetParams("ss", &key, &value))
+	if ( ! stackGetArgs("gsc_player_set_userinfo", &key, &value))
 	{
-		stackError("gsc_player_set_userinfo() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -299,9 +295,8 @@ void gsc_player_stance_set(scr_entref_t id)
 {
 	char *stance;
 
-	if ( ! stackGetParams("s", &stance))
+	if ( ! stackGetArgs("gsc_player_stance_set", &stance))
 	{
-		stackError("gsc_player_stance_set() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -448,9 +443,8 @@ void gsc_player_renameclient(scr_entref_t id)
 {
 	char *name;
 
-	if ( ! stackGetParams("s", &name))
+	if ( ! stackGetArgs("gsc_player_renameclient", &name))
 	{
-		stackError("gsc_player_renameclient() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -481,9 +475,8 @@ void gsc_player_outofbandprint(scr_entref_t id)
 {
 	char *cmd;
 
-	if ( ! stackGetParams("s", &cmd))
+	if ( ! stackGetArgs("gsc_player_outofbandprint", &cmd))
 	{
-		stackError("gsc_player_outofbandprint() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -505,9 +498,8 @@ void gsc_player_connectionlesspacket(scr_entref_t id)
 {
 	char *cmd;
 
-	if ( ! stackGetParams("s", &cmd))
+	if ( ! stackGetArgs("gsc_player_connectionlesspacket", &cmd))
 	{
-		stackError("gsc_player_connectionlesspacket() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -602,9 +594,8 @@ void gsc_player_setg_speed(scr_entref_t id)
 {
 	int speed;
 
-	if ( ! stackGetParams("i", &speed))
+	if ( ! stackGetArgs("gsc_player_setg_speed", &speed))
 	{
-		stackError("gsc_player_setg_speed() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -633,9 +624,8 @@ void gsc_player_setg_gravity(scr_entref_t id)
 {
 	int gravity;
 
-	if ( ! stackGetParams("i", &gravity))
+	if ( ! stackGetArgs("gsc_player_setg_gravity", &gravity))
 	{
-		stackError("gsc_player_setg_gravity() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -664,9 +654,8 @@ void gsc_player_setweaponfiremeleedelay(scr_entref_t id)
 {
 	int delay;
 
-	if ( ! stackGetParams("i", &delay))
+	if ( ! stackGetArgs("gsc_player_setweaponfiremeleedelay", &delay))
 	{
-		stackError("gsc_player_setweaponfiremeleedelay() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -695,9 +684,8 @@ void gsc_player_set_anim(scr_entref_t id)
 {
 	char *animation;
 
-	if ( ! stackGetParams("s", &animation))
+	if ( ! stackGetArgs("gsc_player_set_anim", &animation))
 	{
-		stackError("gsc_player_set_anim() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -731,9 +719,8 @@ void gsc_kick_slot()
 	int id;
 	char* msg;
 
-	if ( ! stackGetParams("is", &id, &msg))
+	if ( ! stackGetArgs("gsc_kick_slot", &id, &msg))
 	{
-		stackError("gsc_kick_slot() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -767,9 +754,8 @@ void gsc_player_setguid(scr_entref_t id)
 {
 	int guid;
 
-	if ( ! stackGetParams("i", &guid))
+	if ( ! stackGetArgs("gsc_player_setguid", &guid))
 	{
-		stackError("gsc_player_setguid() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -791,9 +777,8 @@ void gsc_player_clienthasclientmuted(scr_entref_t id)
 {
 	int id2;
 
-	if ( ! stackGetParams("i", &id2))
+	if ( ! stackGetArgs("gsc_player_clienthasclientmuted", &id2))
 	{
-		stackError("gsc_player_clienthasclientmuted() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -892,4 +877,113 @@ void gsc_player_getcurrentoffhandslotammo(scr_entref_t id)
 	stackPushInt(ps->ammoclip[ps->offHandIndex - 1]);
 }
 
+extern cvar_t *sv_maxclients;
+extern int SV_ClientNetStats(int clientnum, int *ping, int *jitter, int *loss, int *minPing, int *maxPing);
+
+void gsc_player_getsmoothping(scr_entref_t id)
+{
+	if (id >= MAX_CLIENTS)
+	{
+		stackError("gsc_player_getsmoothping() entity %i is not a player", id);
+		stackPushUndefined();
+		return;
+	}
+
+	int ping, jitter, loss, minPing, maxPing;
+	SV_ClientNetStats(id, &ping, &jitter, &loss, &minPing, &maxPing);
+
+	stackPushInt(ping);
+}
+
+void gsc_player_getjitter(scr_entref_t id)
+{
+	if (id >= MAX_CLIENTS)
+	{
+		stackError("gsc_player_getjitter() entity %i is not a player", id);
+		stackPushUndefined();
+		return;
+	}
+
+	int ping, jitter, loss, minPing, maxPing;
+	SV_ClientNetStats(id, &ping, &jitter, &loss, &minPing, &maxPing);
+
+	stackPushInt(jitter);
+}
+
+void gsc_player_getpacketloss(scr_entref_t id)
+{
+	if (id >= MAX_CLIENTS)
+	{
+		stackError("gsc_player_getpacketloss() entity %i is not a player", id);
+		stackPushUndefined();
+		return;
+	}
+
+	int ping, jitter, loss, minPing, maxPing;
+	SV_ClientNetStats(id, &ping, &jitter, &loss, &minPing, &maxPing);
+
+	stackPushInt(loss);
+}
+
+// [smoothed ping, jitter, loss percent, min ping, max ping], undefined before the first snapshot
+void gsc_player_getnetstats(scr_entref_t id)
+{
+	if (id >= MAX_CLIENTS)
+	{
+		stackError("gsc_player_getnetstats() entity %i is not a player", id);
+		stackPushUndefined();
+		return;
+	}
+
+	int ping, jitter, loss, minPing, maxPing;
+
+	if ( ! SV_ClientNetStats(id, &ping, &jitter, &loss, &minPing, &maxPing))
+	{
+		stackPushUndefined();
+		return;
+	}
+
+	stackPushArray();
+	stackPushInt(ping);
+	stackPushArrayLast();
+	stackPushInt(jitter);
+	stackPushArrayLast();
+	stackPushInt(loss);
+	stackPushArrayLast();
+	stackPushInt(minPing);
+	stackPushArrayLast();
+	stackPushInt(maxPing);
+	stackPushArrayLast();
+}
+
+// One [clientnum, smoothed ping, jitter, loss percent, min ping, max ping] per measured client
+void gsc_getallnetstats()
+{
+	stackPushArray();
+
+	for (int i = 0; i < sv_maxclients->integer && i < MAX_CLIENTS; i++)
+	{
+		int ping, jitter, loss, minPing, maxPing;
+
+		if ( ! SV_ClientNetStats(i, &ping, &jitter, &loss, &minPing, &maxPing))
+			continue;
+
+		stackPushArray();
+		stackPushInt(i);
+		stackPushArrayLast();
+		stackPushInt(ping);
+		stackPushArrayLast();
+		stackPushInt(jitter);
+		stackPushArrayLast();
+		stackPushInt(loss);
+		stackPushArrayLast();
+		stackPushInt(minPing);
+		stackPushArrayLast();
+		stackPushInt(maxPing);
+		stackPushArrayLast();
+
+		stackPushArrayLast();
+	}
+}
+
 #endif
@@ -51,8 +51,13 @@ void gsc_player_isbot(scr_entref_t id);
 void gsc_player_disableitempickup(scr_entref_t id);
 void gsc_player_enableitempickup(scr_entref_t id);
 void gsc_player_getcurrentoffhandslotammo(scr_entref_t id);
+void gsc_player_getsmoothping(scr_entref_t id);
+void gsc_player_getjitter(scr_entref_t id);
+void gsc_player_getpacketloss(scr_entref_t id);
+void gsc_player_getnetstats(scr_entref_t id);
 
 // player functions without entity
 void gsc_kick_slot();
+void gsc_getallnetstats();
 
 #endif
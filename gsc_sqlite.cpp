@@ -12,15 +12,6 @@
 
 #define SQLITE_TIMEOUT 2000
 
-enum
-{
-	INT_VALUE,
-	FLOAT_VALUE,
-	STRING_VALUE,
-	VECTOR_VALUE,
-	OBJECT_VALUE
-};
-
 struct async_sqlite_task
 {
 	async_sqlite_task *prev;
@@ -38,15 +29,11 @@ struct async_sqlite_task
 	bool save;
 	bool error;
 	char errorMessage[MAX_STRINGLENGTH];
-	bool hasargument;
-	int valueType;
-	int intValue;
-	float floatValue;
-	char stringValue[MAX_STRINGLENGTH];
-	vec3_t vectorValue;
-	unsigned int objectValue;
+	stackSavedArgs_t args;
 	bool hasentity;
 	gentity_t *gentity;
+	unsigned int levelId;
+	int handle;
 };
 
 struct sqlite_db_store
@@ -75,6 +62,8 @@ void free_sqlite_db_stores_and_tasks()
 		if (task->statement != NULL)
 			sqlite3_finalize(task->statement);
 
+		stackFreeSavedArgs(&task->args);
+
 		if (task->next != NULL)
 			task->next->prev = task->prev;
 
@@ -177,7 +166,7 @@ void *async_sqlite_query_handler(void* dummy)
 						}
 						else if (task->result == SQLITE_ROW)
 						{
-							if (task->save && task->callback)
+							if (task->save && (task->callback || task->handle >= 0))
 							{
 								if (task->fields_size > MAX_SQLITE_FIELDS - 1)
 									break;
@@ -326,45 +315,12 @@ void gsc_async_sqlite_create_query()
 	newtask->done = false;
 	newtask->save = true;
 	newtask->error = false;
-	newtask->hasargument = true;
 	newtask->hasentity = false;
 	newtask->gentity = NULL;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(3, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(3, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(3, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(3, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(3, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(3, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -430,45 +386,12 @@ void gsc_async_sqlite_create_query_nosave()
 	newtask->done = false;
 	newtask->save = false;
 	newtask->error = false;
-	newtask->hasargument = true;
 	newtask->hasentity = false;
 	newtask->gentity = NULL;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(3, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(3, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(3, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(3, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(3, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(3, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -534,45 +457,12 @@ void gsc_async_sqlite_create_entity_query(scr_entref_t entid)
 	newtask->done = false;
 	newtask->save = true;
 	newtask->error = false;
-	newtask->hasargument = true;
 	newtask->hasentity = true;
 	newtask->gentity = &g_entities[entid];
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(3, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(3, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(3, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(3, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(3, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(3, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -638,45 +528,12 @@ void gsc_async_sqlite_create_entity_query_nosave(scr_entref_t entid)
 	newtask->done = false;
 	newtask->save = false;
 	newtask->error = false;
-	newtask->hasargument = true;
 	newtask->hasentity = true;
 	newtask->gentity = &g_entities[entid];
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = -1;
 
-	int valueInt;
-	float valueFloat;
-	char *valueString;
-	vec3_t valueVector;
-	unsigned int valueObject;
-
-	if (stackGetParamInt(3, &valueInt))
-	{
-		newtask->valueType = INT_VALUE;
-		newtask->intValue = valueInt;
-	}
-	else if (stackGetParamFloat(3, &valueFloat))
-	{
-		newtask->valueType = FLOAT_VALUE;
-		newtask->floatValue = valueFloat;
-	}
-	else if (stackGetParamString(3, &valueString))
-	{
-		newtask->valueType = STRING_VALUE;
-		strcpy(newtask->stringValue, valueString);
-	}
-	else if (stackGetParamVector(3, valueVector))
-	{
-		newtask->valueType = VECTOR_VALUE;
-		newtask->vectorValue[0] = valueVector[0];
-		newtask->vectorValue[1] = valueVector[1];
-		newtask->vectorValue[2] = valueVector[2];
-	}
-	else if (stackGetParamObject(3, &valueObject))
-	{
-		newtask->valueType = OBJECT_VALUE;
-		newtask->objectValue = valueObject;
-	}
-	else
-		newtask->hasargument = false;
+	stackSaveArgs(3, &newtask->args);
 
 	if (current != NULL)
 		current->next = newtask;
@@ -686,127 +543,155 @@ void gsc_async_sqlite_create_entity_query_nosave(scr_entref_t entid)
 	stackPushBool(qtrue);
 }
 
-void gsc_async_sqlite_checkdone()
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_async_sqlite_create_query_await()
 {
-	async_sqlite_task *current = first_async_sqlite_task;
+	int db;
+	char *query;
 
-	while (current != NULL)
+	if ( ! stackGetParams("is", &db, &query))
 	{
-		async_sqlite_task *task = current;
-		current = current->next;
+		stackError("gsc_async_sqlite_create_query_await() one or more arguments is undefined or has a wrong type");
+		stackPushUndefined();
+		return;
+	}
 
-		if (task->done)
+	if (!async_sqlite_initialized)
+	{
+		stackError("gsc_async_sqlite_create_query_await() async handler has not been initialized");
+		stackPushUndefined();
+		return;
+	}
+
+	async_sqlite_task *current = first_async_sqlite_task;
+
+	int task_count = 0;
+
+	while (current != NULL && current->next != NULL)
+	{
+		if (task_count > MAX_SQLITE_TASKS - 1)
 		{
-			if (!task->error)
-			{
-				if (task->save && task->callback)
-				{
-					if (task->hasentity)
-					{
-						if (task->gentity != NULL)
-						{
-							if (task->hasargument)
-							{
-								switch(task->valueType)
-								{
-								case INT_VALUE:
-									stackPushInt(task->intValue);
-									break;
+			stackError("gsc_async_sqlite_create_query_await() exceeded async task limit");
+			stackPushUndefined();
+			return;
+		}
 
-								case FLOAT_VALUE:
-									stackPushFloat(task->floatValue);
-									break;
+		current = current->next;
+		task_count++;
+	}
 
-								case STRING_VALUE:
-									stackPushString(task->stringValue);
-									break;
+	int handle = await_handle_spawn();
 
-								case VECTOR_VALUE:
-									stackPushVector(task->vectorValue);
-									break;
+	if (handle < 0)
+	{
+		stackError("gsc_async_sqlite_create_query_await() too many awaits are pending");
+		stackPushUndefined();
+		return;
+	}
 
-								case OBJECT_VALUE:
-									stackPushObject(task->objectValue);
-									break;
+	async_sqlite_task *newtask = new async_sqlite_task;
 
-								default:
-									stackPushUndefined();
-									break;
-								}
-							}
+	newtask->prev = current;
+	newtask->next = NULL;
 
-							stackPushArray();
+	newtask->db = (sqlite3 *)db;
+	newtask->statement = NULL;
 
-							for (int i = 0; i < task->fields_size; i++)
-							{
-								stackPushArray();
+	strncpy(newtask->query, query, MAX_STRINGLENGTH - 1);
+	newtask->query[MAX_STRINGLENGTH - 1] = '\0';
 
-								for (int x = 0; x < task->rows_size; x++)
-								{
-									if (task->row[i][x] != NULL)
-									{
-										stackPushString(task->row[i][x]);
-										stackPushArrayLast();
-									}
-								}
+	newtask->callback = 0;
+	newtask->done = false;
+	newtask->save = true;
+	newtask->error = false;
+	newtask->hasentity = false;
+	newtask->gentity = NULL;
+	newtask->levelId = scrVarPub.levelId;
+	newtask->handle = handle;
+	newtask->args.count = 0;
+	newtask->args.values = NULL;
 
-								stackPushArrayLast();
-							}
+	if (current != NULL)
+		current->next = newtask;
+	else
+		first_async_sqlite_task = newtask;
 
-							short ret = Scr_ExecEntThread(task->gentity, task->callback, task->save + task->hasargument);
-							Scr_FreeThread(ret);
-						}
-					}
-					else
-					{
-						if (task->hasargument)
-						{
-							switch(task->valueType)
-							{
-							case INT_VALUE:
-								stackPushInt(task->intValue);
-								break;
+	stackPushEntity(&g_entities[newtask->handle]);
+}
+#endif
 
-							case FLOAT_VALUE:
-								stackPushFloat(task->floatValue);
-								break;
+static void async_sqlite_push_rows(async_sqlite_task *task)
+{
+	stackPushArray();
 
-							case STRING_VALUE:
-								stackPushString(task->stringValue);
-								break;
+	for (int i = 0; i < task->fields_size; i++)
+	{
+		stackPushArray();
 
-							case VECTOR_VALUE:
-								stackPushVector(task->vectorValue);
-								break;
+		for (int x = 0; x < task->rows_size; x++)
+		{
+			stackPushString(task->row[i][x]);
+			stackPushArrayLast();
+		}
 
-							default:
-								stackPushUndefined();
-								break;
-							}
-						}
+		stackPushArrayLast();
+	}
+}
 
-						stackPushArray();
+void sqlite_async_deliver()
+{
+	async_sqlite_task *current = first_async_sqlite_task;
 
-						for (int i = 0; i < task->fields_size; i++)
-						{
-							stackPushArray();
+	while (current != NULL)
+	{
+		async_sqlite_task *task = current;
+		current = current->next;
 
-							for (int x = 0; x < task->rows_size; x++)
-							{
-								stackPushString(task->row[i][x]);
-								stackPushArrayLast();
-							}
+		if (task->done)
+		{
+			if (task->error)
+				Com_Printf("async sqlite query error in '%s' - '%s'\n", task->query, task->errorMessage);
 
-							stackPushArrayLast();
-						}
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+			if (task->handle >= 0)
+			{
+				//wake the waiting script thread
+				if (await_handle_valid(task->handle, task->levelId))
+				{
+					if (!task->error)
+						async_sqlite_push_rows(task);
+					else
+						stackPushUndefined();
 
-						short ret = Scr_ExecThread(task->callback, task->save + task->hasargument);
+					await_handle_notify(task->handle, 1);
+				}
+			}
+			else
+#endif
+			if (!task->error && task->save && task->callback && Scr_IsSystemActive() && (scrVarPub.levelId == task->levelId))
+			{
+				if (task->hasentity)
+				{
+					if (task->gentity != NULL)
+					{
+						stackPushSavedArgs(&task->args);
+						async_sqlite_push_rows(task);
+
+						short ret = Scr_ExecEntThread(task->gentity, task->callback, task->save + task->args.count);
 						Scr_FreeThread(ret);
 					}
 				}
+				else
+				{
+					stackPushSavedArgs(&task->args);
+					async_sqlite_push_rows(task);
+
+					short ret = Scr_ExecThread(task->callback, task->save + task->args.count);
+					Scr_FreeThread(ret);
+				}
 			}
-			else
-				stackError("gsc_async_sqlite_checkdone() query error in '%s' - '%s'", task->query, task->errorMessage);
+
+			stackFreeSavedArgs(&task->args);
 
 			if (task->next != NULL)
 				task->next->prev = task->prev;
@@ -821,6 +706,12 @@ void gsc_async_sqlite_checkdone()
 	}
 }
 
+void gsc_async_sqlite_checkdone()
+{
+	// results are delivered every server frame, kept for older scripts
+	sqlite_async_deliver();
+}
+
 void gsc_sqlite_open()
 {
 	char *database;
@@ -1012,4 +903,26 @@ void gsc_sqlite_escape_string()
 	sqlite3_free(result);
 }
 
+// Queries not finished yet, -1 when the queue is locked by the query thread
+int sqlite_async_pending()
+{
+	if (!async_sqlite_initialized)
+		return 0;
+
+	if (pthread_mutex_trylock(&async_sqlite_server_spawn) != 0)
+		return -1;
+
+	int pending = 0;
+
+	for (async_sqlite_task *task = first_async_sqlite_task; task != NULL; task = task->next)
+	{
+		if (!task->done)
+			pending++;
+	}
+
+	pthread_mutex_unlock(&async_sqlite_server_spawn);
+
+	return pending;
+}
+
 #endif
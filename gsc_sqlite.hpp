@@ -17,6 +17,12 @@ void gsc_async_sqlite_checkdone();
 void gsc_async_sqlite_create_entity_query(scr_entref_t entid);
 void gsc_async_sqlite_create_entity_query_nosave(scr_entref_t entid);
 
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void gsc_async_sqlite_create_query_await();
+#endif
+
 void free_sqlite_db_stores_and_tasks();
+void sqlite_async_deliver();
+int sqlite_async_pending();
 
 #endif
@@ -2,6 +2,22 @@
 
 #if COMPILE_UTILS == 1
 
+#if COMPILE_RESOLVER == 1
+#include "net_resolver.hpp"
+#endif
+
+#if COMPILE_ASYNCLOG == 1
+#include "async_log.hpp"
+#endif
+
+#if COMPILE_EVENTLOG == 1
+#include "event_log.hpp"
+#endif
+
+#if COMPILE_PERFSTATS == 1
+#include "perf_stats.hpp"
+#endif
+
 //thanks to riicchhaarrd/php
 void gsc_utils_getarraykeys()
 {
@@ -67,6 +83,18 @@ void Sys_AnsiColorPrint( const char *msg )
 		0   // COLOR_WHITE
 	};
 
+#if COMPILE_ASYNCLOG == 1
+	if ( async_log_running() )
+	{
+		// the writer thread translates the colors, the stdout lock keeps the order with buffered text
+		flockfile( stdout );
+		fflush_unlocked( stdout );
+		async_log_write( msg, strlen( msg ), 1 );
+		funlockfile( stdout );
+		return;
+	}
+#endif
+
 	while( *msg )
 	{
 		if( Q_IsColorString( msg ) || *msg == '\n' )
@@ -158,9 +186,8 @@ void gsc_utils_printf()
 {
 	char *str;
 
-	if ( ! stackGetParams("s", &str))
+	if ( ! stackGetArgs("gsc_utils_printf", &str))
 	{
-		stackError("gsc_utils_printf() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -192,26 +219,183 @@ void gsc_utils_outofbandprint()
 	char * address;
 	char * msg;
 
-	if (!stackGetParams("ss", &address, &msg))
+	if (!stackGetArgs("gsc_utils_outofbandprint", &address, &msg))
 	{
-		stackError("gsc_utils_outofbandprint() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
 
+#if COMPILE_RESOLVER == 1
+	// hostnames are resolved in the background, the message is sent once the address is known
+	stackPushInt(net_resolver_send_oob(address, msg));
+#else
 	netadr_t from;
 	NET_StringToAdr(address, &from);
 	NET_OutOfBandPrint(NS_SERVER, from, msg);
+#endif
+}
+
+#if COMPILE_RESOLVER == 1
+void gsc_utils_resolve_async()
+{
+	char *address;
+	int callback;
+
+	if (!stackGetParamString(0, &address) || !stackGetParamFunction(1, &callback))
+	{
+		stackError("gsc_utils_resolve_async() one or more arguments is undefined or has a wrong type");
+		stackPushUndefined();
+		return;
+	}
+
+	stackSavedArgs_t args;
+	stackSaveArgs(2, &args);
+
+	stackPushInt(net_resolver_request(address, callback, &args));
+}
+#endif
+
+#if COMPILE_EVENTLOG == 1
+// logevent(name, args...) appends a binary record, players passed in are stored as entity numbers
+void gsc_utils_logevent()
+{
+	char *name;
+
+	if ( ! stackGetArgs("gsc_utils_logevent", &name))
+	{
+		stackPushUndefined();
+		return;
+	}
+
+	if (strlen(name) > EVENT_LOG_MAX_NAME)
+	{
+		stackError("gsc_utils_logevent() event name is longer than %i characters", EVENT_LOG_MAX_NAME);
+		stackPushUndefined();
+		return;
+	}
+
+	byte fields[EVENT_LOG_MAX_RECORD - sizeof(eventLogRecord_t)];
+	int length = 0;
+	int client = -1;
+	int num = Scr_GetNumParam();
+
+	for (int i = 1; i < num; i++)
+	{
+		VariableValue *var = &scrVmPub.top[-i];
+
+		// the largest field is a string
+		if (length + 2 + 255 > (int)sizeof(fields))
+		{
+			stackError("gsc_utils_logevent() too many arguments");
+			stackPushUndefined();
+			return;
+		}
+
+		switch (var->type)
+		{
+		case STACK_INT:
+			fields[length++] = EVENT_FIELD_INT;
+			memcpy(&fields[length], &var->u.intValue, sizeof(int));
+			length += sizeof(int);
+			break;
+
+		case STACK_FLOAT:
+			fields[length++] = EVENT_FIELD_FLOAT;
+			memcpy(&fields[length], &var->u.floatValue, sizeof(float));
+			length += sizeof(float);
+			break;
+
+		case STACK_VECTOR:
+			fields[length++] = EVENT_FIELD_VECTOR;
+			memcpy(&fields[length], var->u.vectorValue, sizeof(vec3_t));
+			length += sizeof(vec3_t);
+			break;
+
+		case STACK_STRING:
+		case STACK_LOCALIZED_STRING:
+		{
+			const char *str = SL_ConvertToString(var->u.stringValue);
+			int len = strlen(str) > 255 ? 255 : strlen(str);
+
+			fields[length++] = EVENT_FIELD_STRING;
+			fields[length++] = len;
+			memcpy(&fields[length], str, len);
+			length += len;
+			break;
+		}
+
+		case STACK_OBJECT:
+		{
+			VariableValueInternal *object = &scrVarGlob[var->u.pointerValue];
+
+			// only game entities, classnum 0
+			if ((object->w.type & 0x1F) == STACK_ENTITY && (object->w.classnum >> 8) == 0)
+			{
+				u_int16_t entnum = object->u.o.u.entnum;
+
+				fields[length++] = EVENT_FIELD_ENTITY;
+				memcpy(&fields[length], &entnum, sizeof(u_int16_t));
+				length += sizeof(u_int16_t);
+
+				// the first player is the one the event belongs to
+				if (client < 0 && entnum < MAX_CLIENTS)
+					client = entnum;
+				break;
+			}
+
+			fields[length++] = EVENT_FIELD_UNDEFINED;
+			break;
+		}
+
+		default:
+			fields[length++] = EVENT_FIELD_UNDEFINED;
+			break;
+		}
+	}
+
+	stackPushBool(event_log_append(name, client, fields, length, num - 1));
 }
+#endif
+
+#if COMPILE_PERFSTATS == 1
+// One array per phase: name, frames, avg, p50, p90, p99, max (microseconds over the last frames)
+void gsc_utils_getperfstats()
+{
+	stackPushArray();
+
+	for (int i = 0; i < PERF_PHASES; i++)
+	{
+		perfStats_t stats;
+		perf_phase_stats(i, &stats);
+
+		stackPushArray();
+		stackPushString(perf_phase_name(i));
+		stackPushArrayLast();
+		stackPushInt(stats.samples);
+		stackPushArrayLast();
+		stackPushInt(stats.avg);
+		stackPushArrayLast();
+		stackPushInt(stats.p50);
+		stackPushArrayLast();
+		stackPushInt(stats.p90);
+		stackPushArrayLast();
+		stackPushInt(stats.p99);
+		stackPushArrayLast();
+		stackPushInt(stats.max);
+		stackPushArrayLast();
+
+		stackPushArrayLast();
+	}
+}
+#endif
 
 void gsc_utils_sprintf()
 {
 	char result[MAX_STRINGLENGTH];
 	char *str;
 
-	if (!stackGetParams("s", &str))
+	if (!stackGetArgs("gsc_utils_sprintf", &str))
 	{
-		stackError("gsc_utils_sprintf() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -277,9 +461,8 @@ void gsc_utils_getAscii()
 {
 	char *str;
 
-	if ( ! stackGetParams("s", &str))
+	if ( ! stackGetArgs("gsc_utils_getAscii", &str))
 	{
-		stackError("gsc_utils_getAscii() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -298,9 +481,8 @@ void gsc_utils_putchar()
 {
 	int val;
 
-	if ( ! stackGetParams("i",  &val))
+	if ( ! stackGetArgs("gsc_utils_putchar", &val))
 	{
-		stackError("gsc_utils_putchar() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -324,9 +506,8 @@ void gsc_utils_toupper()
 {
 	char *str;
 
-	if ( ! stackGetParams("s", &str))
+	if ( ! stackGetArgs("gsc_utils_toupper", &str))
 	{
-		stackError("gsc_utils_toupper() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -345,9 +526,8 @@ void gsc_utils_system()
 {
 	char *cmd;
 
-	if ( ! stackGetParams("s",  &cmd))
+	if ( ! stackGetArgs("gsc_utils_system", &cmd))
 	{
-		stackError("gsc_utils_system() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -389,9 +569,8 @@ void gsc_utils_exponent()
 	float basis;
 	float exponent;
 
-	if ( ! stackGetParams("ff", &basis, &exponent))
+	if ( ! stackGetArgs("gsc_utils_exponent", &basis, &exponent))
 	{
-		stackError("gsc_utils_exponent() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -403,9 +582,8 @@ void gsc_utils_round()
 {
 	float val;
 
-	if ( ! stackGetParams("f",  &val))
+	if ( ! stackGetArgs("gsc_utils_round", &val))
 	{
-		stackError("gsc_utils_round() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -417,9 +595,8 @@ void gsc_utils_file_link()
 {
 	char *source, *dest;
 
-	if ( ! stackGetParams("ss",  &source, &dest))
+	if ( ! stackGetArgs("gsc_utils_file_link", &source, &dest))
 	{
-		stackError("gsc_utils_file_link() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -432,9 +609,8 @@ void gsc_utils_file_unlink()
 {
 	char *file;
 
-	if ( ! stackGetParams("s",  &file))
+	if ( ! stackGetArgs("gsc_utils_file_unlink", &file))
 	{
-		stackError("gsc_utils_file_unlink() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -447,9 +623,8 @@ void gsc_utils_file_exists()
 {
 	char *filename;
 
-	if ( ! stackGetParams("s", &filename))
+	if ( ! stackGetArgs("gsc_utils_file_exists", &filename))
 	{
-		stackError("gsc_utils_file_exists() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -458,17 +633,64 @@ void gsc_utils_file_exists()
 	stackPushInt( file_exists );
 }
 
+void gsc_utils_preloadmap()
+{
+	extern int manymaps_preload(const char *mapname);
+	char *mapname;
+
+	if ( ! stackGetArgs("gsc_utils_preloadmap", &mapname))
+	{
+		stackPushUndefined();
+		return;
+	}
+
+	stackPushInt(manymaps_preload(mapname));
+}
+
+void gsc_utils_getpreloadstatus()
+{
+	extern int manymaps_preload_status(char *mapname, int size, int *warmed, int *total);
+	char mapname[MAX_QPATH];
+	int warmed, total;
+
+	if ( ! manymaps_preload_status(mapname, sizeof(mapname), &warmed, &total))
+	{
+		stackPushUndefined();
+		return;
+	}
+
+	// [mapname, bytes warmed, total bytes]
+	stackPushArray();
+	stackPushString(mapname);
+	stackPushArrayLast();
+	stackPushInt(warmed);
+	stackPushArrayLast();
+	stackPushInt(total);
+	stackPushArrayLast();
+}
+
 void gsc_utils_FS_LoadDir()
 {
-	char *path, *dir;
+	char *path, *dir, *iwd = NULL;
 
-	if ( ! stackGetParams("ss", &path, &dir))
+	if ( ! stackGetArgsOpt("gsc_utils_FS_LoadDir", 2, &path, &dir, &iwd))
 	{
-		stackError("gsc_utils_FS_LoadDir() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
 
+	// fs_loaddir(path, dir, iwd) registers only that iwd instead of rescanning the directory
+	if (iwd)
+	{
+		extern int FS_LoadIwd(const char *dir, const char *file);
+
+		char file[MAX_OSPATH * 2];
+
+		snprintf(file, sizeof(file), "%s/%s/%s", path, dir, iwd);
+		stackPushBool(FS_LoadIwd(dir, file));
+		return;
+	}
+
 	FS_LoadDir(path, dir);
 	stackPushBool(qtrue);
 }
@@ -525,9 +747,8 @@ void gsc_utils_ExecuteString()
 {
 	char *str;
 
-	if ( ! stackGetParams("s", &str))
+	if ( ! stackGetArgs("gsc_utils_ExecuteString", &str))
 	{
-		stackError("gsc_utils_ExecuteString() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -541,9 +762,8 @@ void gsc_utils_sendgameservercommand()
 	int clientNum;
 	char *message;
 
-	if ( ! stackGetParams("is", &clientNum, &message))
+	if ( ! stackGetArgs("gsc_utils_sendgameservercommand", &clientNum, &message))
 	{
-		stackError("gsc_utils_sendgameservercommand() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -556,9 +776,8 @@ void gsc_utils_scandir()
 {
 	char *dirname;
 
-	if ( ! stackGetParams("s", &dirname))
+	if ( ! stackGetArgs("gsc_utils_scandir", &dirname))
 	{
-		stackError("gsc_utils_scandir() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -590,9 +809,8 @@ void gsc_utils_fopen()
 	FILE *file;
 	char *filename, *mode;
 
-	if ( ! stackGetParams("ss", &filename, &mode))
+	if ( ! stackGetArgs("gsc_utils_fopen", &filename, &mode))
 	{
-		stackError("gsc_utils_fopen() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -713,9 +931,8 @@ void gsc_G_FindConfigstringIndexOriginal()
 	char *name;
 	int min, max, create;
 
-	if ( ! stackGetParams("siii", &name, &min, &max, &create))
+	if ( ! stackGetArgs("gsc_G_FindConfigstringIndexOriginal", &name, &min, &max, &create))
 	{
-		stackError("gsc_G_FindConfigstringIndexOriginal() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -729,9 +946,8 @@ void gsc_G_FindConfigstringIndex()
 	char *name;
 	int min, max;
 
-	if ( ! stackGetParams("sii", &name, &min, &max))
+	if ( ! stackGetArgs("gsc_G_FindConfigstringIndex", &name, &min, &max))
 	{
-		stackError("gsc_G_FindConfigstringIndex() one or more arguments is undefined or has a wrong type");
 		return;
 	}
 
@@ -756,9 +972,8 @@ void gsc_get_configstring()
 {
 	int index;
 
-	if ( ! stackGetParams("i", &index))
+	if ( ! stackGetArgs("gsc_get_configstring", &index))
 	{
-		stackError("gsc_get_configstring() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -776,9 +991,8 @@ void gsc_set_configstring()
 	int index;
 	char *string;
 
-	if ( ! stackGetParams("is", &index, &string))
+	if ( ! stackGetArgs("gsc_set_configstring", &index, &string))
 	{
-		stackError("gsc_set_configstring() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -791,9 +1005,8 @@ void gsc_utils_sqrt()
 {
 	float x;
 
-	if ( ! stackGetParams("f", &x))
+	if ( ! stackGetArgs("gsc_utils_sqrt", &x))
 	{
-		stackError("gsc_utils_sqrt() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -805,9 +1018,8 @@ void gsc_utils_sqrtInv()
 {
 	float x;
 
-	if ( ! stackGetParams("f", &x))
+	if ( ! stackGetArgs("gsc_utils_sqrtInv", &x))
 	{
-		stackError("gsc_utils_sqrtInv() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -826,9 +1038,8 @@ void gsc_make_localized_string()
 {
 	char *str;
 
-	if ( ! stackGetParams("s", &str))
+	if ( ! stackGetArgs("gsc_make_localized_string", &str))
 	{
-		stackError("gsc_make_localized_string() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -862,9 +1073,8 @@ void gsc_utils_bullethiteffect()
 	vec3_t origin;
 	vec3_t normal;
 
-	if ( ! stackGetParams("vv", &origin, &normal))
+	if ( ! stackGetArgs("gsc_utils_bullethiteffect", &origin, &normal))
 	{
-		stackError("gsc_utils_bullethiteffect() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -887,9 +1097,8 @@ void gsc_utils_vectorscale()
 	vec3_t vector;
 	float scale;
 
-	if ( ! stackGetParams("vf", &vector, &scale))
+	if ( ! stackGetArgs("gsc_utils_vectorscale", &vector, &scale))
 	{
-		stackError("gsc_utils_vectorscale() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -904,9 +1113,8 @@ void gsc_utils_remove_file()
 {
 	char *filename;
 
-	if (!stackGetParams("s", &filename))
+	if (!stackGetArgs("gsc_utils_remove_file", &filename))
 	{
-		stackError("gsc_utils_remove_file() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -919,9 +1127,8 @@ void gsc_utils_remotecommand()
 	char * sFrom;
 	int pointerMsg;
 	
-	if (!stackGetParams("si", &sFrom, &pointerMsg))
+	if (!stackGetArgs("gsc_utils_remotecommand", &sFrom, &pointerMsg))
 	{
-		stackError("gsc_utils_remotecommand() one or more arguments is undefined or has a wrong type");
 		return;
 	}
 	
@@ -6,6 +6,15 @@
 
 void gsc_utils_printf();
 void gsc_utils_outofbandprint();
+#if COMPILE_RESOLVER == 1
+void gsc_utils_resolve_async();
+#endif
+#if COMPILE_EVENTLOG == 1
+void gsc_utils_logevent();
+#endif
+#if COMPILE_PERFSTATS == 1
+void gsc_utils_getperfstats();
+#endif
 void gsc_utils_getarraykeys();
 void gsc_utils_getAscii();
 void gsc_utils_toupper();
@@ -15,6 +24,8 @@ void gsc_utils_round();
 void gsc_utils_file_link();
 void gsc_utils_file_unlink();
 void gsc_utils_file_exists();
+void gsc_utils_preloadmap();
+void gsc_utils_getpreloadstatus();
 void gsc_utils_FS_LoadDir();
 void gsc_utils_getType();
 void gsc_utils_float();
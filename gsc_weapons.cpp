@@ -16,9 +16,8 @@ void gsc_weapons_getweaponmaxammo()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponmaxammo", &id))
 	{
-		stackError("gsc_weapons_getweaponmaxammo() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -38,9 +37,8 @@ void gsc_weapons_getweaponclipsize()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponclipsize", &id))
 	{
-		stackError("gsc_weapons_getweaponclipsize() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -60,9 +58,8 @@ void gsc_weapons_getweapondamage()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweapondamage", &id))
 	{
-		stackError("gsc_weapons_getweapondamage() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -82,9 +79,8 @@ void gsc_weapons_getweaponmeleedamage()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponmeleedamage", &id))
 	{
-		stackError("gsc_weapons_getweaponmeleedamage() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -104,9 +100,8 @@ void gsc_weapons_getweaponfiretime()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponfiretime", &id))
 	{
-		stackError("gsc_weapons_getweaponfiretime() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -126,9 +121,8 @@ void gsc_weapons_getweaponmeleetime()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponmeleetime", &id))
 	{
-		stackError("gsc_weapons_getweaponmeleetime() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -148,9 +142,8 @@ void gsc_weapons_getweaponreloadtime()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponreloadtime", &id))
 	{
-		stackError("gsc_weapons_getweaponreloadtime() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -170,9 +163,8 @@ void gsc_weapons_getweaponreloademptytime()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponreloademptytime", &id))
 	{
-		stackError("gsc_weapons_getweaponreloademptytime() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -192,9 +184,8 @@ void gsc_weapons_getweaponcookable()
 {
 	int id;
 
-	if ( ! stackGetParams("i", &id))
+	if ( ! stackGetArgs("gsc_weapons_getweaponcookable", &id))
 	{
-		stackError("gsc_weapons_getweaponcookable() argument is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -215,9 +206,8 @@ void gsc_weapons_setweapondamage()
 	int id;
 	int damage;
 
-	if ( ! stackGetParams("ii", &id, &damage))
+	if ( ! stackGetArgs("gsc_weapons_setweapondamage", &id, &damage))
 	{
-		stackError("gsc_weapons_setweapondamage() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -240,9 +230,8 @@ void gsc_weapons_setweaponmaxammo()
 	int id;
 	int ammo;
 
-	if ( ! stackGetParams("ii", &id, &ammo))
+	if ( ! stackGetArgs("gsc_weapons_setweaponmaxammo", &id, &ammo))
 	{
-		stackError("gsc_weapons_setweaponmaxammo() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -265,9 +254,8 @@ void gsc_weapons_setweaponclipsize()
 	int id;
 	int clipSize;
 
-	if ( ! stackGetParams("ii", &id, &clipSize))
+	if ( ! stackGetArgs("gsc_weapons_setweaponclipsize", &id, &clipSize))
 	{
-		stackError("gsc_weapons_setweaponclipsize() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -290,9 +278,8 @@ void gsc_weapons_setweaponmeleedamage()
 	int id;
 	int damage;
 
-	if ( ! stackGetParams("ii", &id, &damage))
+	if ( ! stackGetArgs("gsc_weapons_setweaponmeleedamage", &id, &damage))
 	{
-		stackError("gsc_weapons_setweaponmeleedamage() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -315,9 +302,8 @@ void gsc_weapons_setweaponfiretime()
 	int id;
 	int time;
 
-	if ( ! stackGetParams("ii", &id, &time))
+	if ( ! stackGetArgs("gsc_weapons_setweaponfiretime", &id, &time))
 	{
-		stackError("gsc_weapons_setweaponfiretime() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -340,9 +326,8 @@ void gsc_weapons_setweaponmeleetime()
 	int id;
 	int time;
 
-	if ( ! stackGetParams("ii", &id, &time))
+	if ( ! stackGetArgs("gsc_weapons_setweaponmeleetime", &id, &time))
 	{
-		stackError("gsc_weapons_setweaponmeleetime() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -365,9 +350,8 @@ void gsc_weapons_setweaponreloadtime()
 	int id;
 	int time;
 
-	if ( ! stackGetParams("ii", &id, &time))
+	if ( ! stackGetArgs("gsc_weapons_setweaponreloadtime", &id, &time))
 	{
-		stackError("gsc_weapons_setweaponreloadtime() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -390,9 +374,8 @@ void gsc_weapons_setweaponreloademptytime()
 	int id;
 	int time;
 
-	if ( ! stackGetParams("ii", &id, &time))
+	if ( ! stackGetArgs("gsc_weapons_setweaponreloademptytime", &id, &time))
 	{
-		stackError("gsc_weapons_setweaponreloademptytime() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -415,9 +398,8 @@ void gsc_weapons_setweaponcookable()
 	int id;
 	int cookable;
 
-	if ( ! stackGetParams("ii", &id, &cookable))
+	if ( ! stackGetArgs("gsc_weapons_setweaponcookable", &id, &cookable))
 	{
-		stackError("gsc_weapons_setweaponcookable() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -457,9 +439,8 @@ void gsc_weapons_getweaponhitlocmultiplier()
 	int id;
 	char *hitloc;
 
-	if ( ! stackGetParams("is", &id, &hitloc))
+	if ( ! stackGetArgs("gsc_weapons_getweaponhitlocmultiplier", &id, &hitloc))
 	{
-		stackError("gsc_weapons_getweaponhitlocmultiplier() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
@@ -483,9 +464,8 @@ void gsc_weapons_setweaponhitlocmultiplier()
 	float multiplier;
 	char* hitloc;
 
-	if ( ! stackGetParams("isf", &id, &hitloc, &multiplier))
+	if ( ! stackGetArgs("gsc_weapons_setweaponhitlocmultiplier", &id, &hitloc, &multiplier))
 	{
-		stackError("gsc_weapons_setweaponhitlocmultiplier() one or more arguments is undefined or has a wrong type");
 		stackPushUndefined();
 		return;
 	}
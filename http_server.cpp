@@ -0,0 +1,460 @@
+#include "http_server.hpp"
+
+#if COMPILE_HTTPSERVER == 1
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+struct http_connection
+{
+	int fd;
+	int file; // -1 until a response body is being sent
+	off_t offset;
+	size_t remaining;
+	char request[HTTP_REQUEST_SIZE];
+	int requestLength;
+	char header[512];
+	int headerLength;
+	int headerSent;
+	time_t lastActive;
+	unsigned int generation; // sent with its epoll events, a reused slot ignores events of the old connection
+};
+
+// Directories files are served from, copied from cvars on the main thread
+struct http_paths
+{
+	char roots[2][MAX_OSPATH]; // fs_homepath, fs_basepath
+	char gamedirs[2][MAX_QPATH]; // main, fs_game
+	char library[MAX_OSPATH];
+};
+
+static http_paths paths;
+static pthread_mutex_t paths_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int http_listener = -1;
+static int http_epoll = -1;
+static int http_stopping = 0; // set by the main thread, the server thread closes everything and exits
+static unsigned int http_generation = 0;
+static http_connection *http_connections[MAX_HTTP_CONNECTIONS];
+
+#define HTTP_EVENT_DATA(slot, generation) ( (uint64_t)(generation) << 32 | (uint32_t)(slot) )
+
+void http_server_update_paths()
+{
+	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
+	cvar_t *fs_basepath = Cvar_FindVar("fs_basepath");
+	cvar_t *fs_game = Cvar_FindVar("fs_game");
+	cvar_t *fs_library = Cvar_FindVar("fs_library");
+
+	pthread_mutex_lock(&paths_mutex);
+
+	memset(&paths, 0, sizeof(paths));
+
+	if (fs_homepath)
+		strncpy(paths.roots[0], fs_homepath->string, sizeof(paths.roots[0]) - 1);
+
+	if (fs_basepath)
+		strncpy(paths.roots[1], fs_basepath->string, sizeof(paths.roots[1]) - 1);
+
+	strcpy(paths.gamedirs[0], "main");
+
+	if (fs_game && *fs_game->string)
+		strncpy(paths.gamedirs[1], fs_game->string, sizeof(paths.gamedirs[1]) - 1);
+
+	// same default as manymaps_prepare
+	if (fs_library && *fs_library->string)
+		strncpy(paths.library, fs_library->string, sizeof(paths.library) - 1);
+	else if (fs_homepath && fs_game && *fs_game->string)
+		snprintf(paths.library, sizeof(paths.library), "%s/%s/Library", fs_homepath->string, fs_game->string);
+
+	pthread_mutex_unlock(&paths_mutex);
+}
+
+// Only "<gamedir>/<name>.iwd" is served, found in the game directories or the map library.
+// The game directory can have several components, fs_game is usually mods/<name>.
+static int http_open_file(const char *url, size_t *size)
+{
+	char path[MAX_OSPATH * 2];
+	const char *gamedir = NULL;
+	const char *name = NULL;
+
+	http_paths current;
+
+	pthread_mutex_lock(&paths_mutex);
+	current = paths;
+	pthread_mutex_unlock(&paths_mutex);
+
+	for (int i = 0; i < 2 && gamedir == NULL; i++)
+	{
+		int length = strlen(current.gamedirs[i]);
+
+		if (length && strncmp(url, current.gamedirs[i], length) == 0 && url[length] == '/')
+		{
+			gamedir = current.gamedirs[i];
+			name = &url[length + 1];
+		}
+	}
+
+	if (gamedir == NULL)
+		return -1;
+
+	int length = strlen(name);
+
+	if (length < 5 || strcmp(&name[length - 4], ".iwd") != 0 || strchr(name, '/') || strchr(name, '\\') || name[0] == '.')
+		return -1;
+
+	int fd = -1;
+
+	for (int i = 0; i < 2 && fd < 0; i++)
+	{
+		if (!*current.roots[i])
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s/%s", current.roots[i], gamedir, name);
+		fd = open(path, O_RDONLY);
+	}
+
+	if (fd < 0 && *current.library)
+	{
+		snprintf(path, sizeof(path), "%s/%s", current.library, name);
+		fd = open(path, O_RDONLY);
+	}
+
+	if (fd < 0)
+		return -1;
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return -1;
+	}
+
+	*size = st.st_size;
+
+	return fd;
+}
+
+static void http_close(int slot)
+{
+	http_connection *connection = http_connections[slot];
+
+	if (connection->file >= 0)
+		close(connection->file);
+
+	close(connection->fd);
+	delete connection;
+
+	http_connections[slot] = NULL;
+}
+
+static void http_respond(http_connection *connection, const char *status, size_t length)
+{
+	connection->headerLength = snprintf(connection->header, sizeof(connection->header),
+	                                    "HTTP/1.1 %s\r\n"
+	                                    "Server: libcod\r\n"
+	                                    "Content-Type: %s\r\n"
+	                                    "Content-Length: %u\r\n"
+	                                    "Connection: close\r\n"
+	                                    "\r\n",
+	                                    status, connection->file >= 0 ? "application/octet-stream" : "text/plain", (unsigned int)length);
+	connection->headerSent = 0;
+}
+
+static void http_parse_request(http_connection *connection)
+{
+	char method[8];
+	char url[MAX_OSPATH];
+
+	if (sscanf(connection->request, "%7s %255s", method, url) != 2)
+	{
+		http_respond(connection, "400 Bad Request", 0);
+		return;
+	}
+
+	if (strcmp(method, "GET") != 0)
+	{
+		http_respond(connection, "405 Method Not Allowed", 0);
+		return;
+	}
+
+	size_t size;
+	int file = url[0] == '/' ? http_open_file(&url[1], &size) : -1;
+
+	if (file < 0)
+	{
+		http_respond(connection, "404 Not Found", 0);
+		return;
+	}
+
+	connection->file = file;
+	connection->offset = 0;
+	connection->remaining = size;
+
+	http_respond(connection, "200 OK", size);
+}
+
+// Returns 0 when the connection is finished or broken
+static int http_write(http_connection *connection)
+{
+	while (connection->headerSent < connection->headerLength)
+	{
+		int sent = send(connection->fd, connection->header + connection->headerSent, connection->headerLength - connection->headerSent, MSG_NOSIGNAL);
+
+		if (sent < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+
+		connection->headerSent += sent;
+	}
+
+	// zero copy from the page cache to the socket
+	while (connection->file >= 0 && connection->remaining > 0)
+	{
+		ssize_t sent = sendfile(connection->fd, connection->file, &connection->offset, connection->remaining);
+
+		if (sent < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+
+		if (sent == 0)
+			return 0;
+
+		connection->remaining -= sent;
+	}
+
+	return 0;
+}
+
+static void http_accept()
+{
+	while (true)
+	{
+		int fd = accept(http_listener, NULL, NULL);
+
+		if (fd < 0)
+			return;
+
+		int slot;
+
+		for (slot = 0; slot < MAX_HTTP_CONNECTIONS; slot++)
+		{
+			if (http_connections[slot] == NULL)
+				break;
+		}
+
+		if (slot == MAX_HTTP_CONNECTIONS)
+		{
+			close(fd);
+			continue;
+		}
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+		http_connection *connection = new http_connection;
+		connection->fd = fd;
+		connection->file = -1;
+		connection->requestLength = 0;
+		connection->headerLength = 0;
+		connection->headerSent = 0;
+		connection->lastActive = time(NULL);
+		connection->generation = ++http_generation;
+
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		event.data.u64 = HTTP_EVENT_DATA(slot, connection->generation);
+
+		if (epoll_ctl(http_epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+		{
+			close(fd);
+			delete connection;
+			continue;
+		}
+
+		http_connections[slot] = connection;
+	}
+}
+
+static void http_handle(int slot, unsigned int generation, unsigned int events)
+{
+	http_connection *connection = http_connections[slot];
+
+	// closed earlier in this batch, the slot may already hold a new connection
+	if (connection == NULL || connection->generation != generation)
+		return;
+
+	connection->lastActive = time(NULL);
+
+	if (events & (EPOLLERR | EPOLLHUP))
+	{
+		http_close(slot);
+		return;
+	}
+
+	if (!connection->headerLength)
+	{
+		while (true)
+		{
+			int received = recv(connection->fd, connection->request + connection->requestLength, sizeof(connection->request) - 1 - connection->requestLength, 0);
+
+			if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+			{
+				http_close(slot);
+				return;
+			}
+
+			if (received < 0)
+				break;
+
+			connection->requestLength += received;
+			connection->request[connection->requestLength] = '\0';
+
+			if (strstr(connection->request, "\r\n\r\n") || strstr(connection->request, "\n\n"))
+			{
+				http_parse_request(connection);
+				break;
+			}
+
+			if (connection->requestLength == sizeof(connection->request) - 1)
+			{
+				http_respond(connection, "400 Bad Request", 0);
+				break;
+			}
+		}
+
+		if (!connection->headerLength)
+			return; // request not complete yet
+	}
+
+	if (!http_write(connection))
+		http_close(slot);
+}
+
+static void *http_server_thread(void *unused)
+{
+	struct epoll_event events[MAX_HTTP_CONNECTIONS + 1];
+
+	while (!__atomic_load_n(&http_stopping, __ATOMIC_ACQUIRE))
+	{
+		int count = epoll_wait(http_epoll, events, MAX_HTTP_CONNECTIONS + 1, 1000);
+
+		for (int i = 0; i < count; i++)
+		{
+			int slot = (uint32_t)events[i].data.u64;
+
+			if (slot == MAX_HTTP_CONNECTIONS)
+				http_accept();
+			else
+				http_handle(slot, events[i].data.u64 >> 32, events[i].events);
+		}
+
+		time_t now = time(NULL);
+
+		for (int slot = 0; slot < MAX_HTTP_CONNECTIONS; slot++)
+		{
+			if (http_connections[slot] != NULL && now - http_connections[slot]->lastActive > HTTP_IDLE_TIMEOUT)
+				http_close(slot);
+		}
+	}
+
+	for (int slot = 0; slot < MAX_HTTP_CONNECTIONS; slot++)
+	{
+		if (http_connections[slot] != NULL)
+			http_close(slot);
+	}
+
+	close(http_epoll);
+	close(http_listener);
+	http_epoll = -1;
+
+	__atomic_store_n(&http_stopping, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&http_listener, -1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+// Stays running until the server thread has closed the listener, within a second
+int http_server_running()
+{
+	return __atomic_load_n(&http_listener, __ATOMIC_ACQUIRE) >= 0;
+}
+
+void http_server_stop()
+{
+	if (!http_server_running() || __atomic_exchange_n(&http_stopping, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	Com_Printf("HTTP download server stopping\n");
+}
+
+int http_server_start(const char *ip, int port)
+{
+	if (http_server_running())
+		return 1;
+
+	http_server_update_paths();
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return 0;
+
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	if (ip == NULL || !*ip || inet_pton(AF_INET, ip, &addr.sin_addr) != 1)
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0)
+	{
+		Com_Printf("http_server_start() could not listen on port %i: %s\n", port, strerror(errno));
+		close(fd);
+		return 0;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	http_epoll = epoll_create(MAX_HTTP_CONNECTIONS + 1);
+
+	if (http_epoll < 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u64 = HTTP_EVENT_DATA(MAX_HTTP_CONNECTIONS, 0); // the listener
+
+	epoll_ctl(http_epoll, EPOLL_CTL_ADD, fd, &event);
+
+	http_listener = fd;
+
+	pthread_t server;
+
+	if (pthread_create(&server, NULL, http_server_thread, NULL) != 0 || pthread_detach(server) != 0)
+	{
+		Com_Printf("http_server_start() error creating http server thread!\n");
+		close(http_epoll);
+		close(fd);
+		http_epoll = -1;
+		http_listener = -1;
+		return 0;
+	}
+
+	Com_Printf("HTTP download server listening on port %i\n", port);
+
+	return 1;
+}
+
+#endif
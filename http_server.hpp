@@ -0,0 +1,15 @@
+#ifndef _HTTP_SERVER_HPP_
+#define _HTTP_SERVER_HPP_
+
+#include "gsc.hpp"
+
+#define MAX_HTTP_CONNECTIONS 64
+#define HTTP_REQUEST_SIZE 2048
+#define HTTP_IDLE_TIMEOUT 30 // seconds a connection may stay silent
+
+int http_server_start(const char *ip, int port);
+void http_server_stop();
+void http_server_update_paths();
+int http_server_running();
+
+#endif
@@ -1,5 +1,47 @@
 #include "gsc.hpp"
 
+#include <pthread.h>
+
+#if COMPILE_RESOLVER == 1
+#include "net_resolver.hpp"
+#endif
+
+#if COMPILE_HTTPSERVER == 1
+#include "http_server.hpp"
+#endif
+
+#if COMPILE_ASYNCLOG == 1
+#include "async_log.hpp"
+#endif
+
+#if COMPILE_EVENTLOG == 1
+#include "event_log.hpp"
+#endif
+
+#if COMPILE_WATCHDOG == 1
+#include "watchdog.hpp"
+#define WATCHDOG_MARK(name) watchdog_enter(name)
+#else
+#define WATCHDOG_MARK(name)
+#endif
+
+#if COMPILE_PERFSTATS == 1
+#include "perf_stats.hpp"
+#define PERF_BEGIN(start) unsigned int start = perf_begin()
+#define PERF_END(phase, start) perf_end(phase, start)
+#else
+#define PERF_BEGIN(start)
+#define PERF_END(phase, start)
+#endif
+
+#if COMPILE_METRICS == 1
+#include "metrics.hpp"
+#endif
+
+#if COMPILE_SHMSTATS == 1
+#include "shm_stats.hpp"
+#endif
+
 cvar_t *sv_maxclients;
 cvar_t *sv_allowDownload;
 cvar_t *sv_pure;
@@ -14,6 +56,9 @@ cvar_t *dedicated;
 #if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
 cvar_t *sv_wwwDownload;
 cvar_t *cl_wwwDownload;
+cvar_t *sv_httpServer;
+cvar_t *sv_httpPort;
+cvar_t *sv_httpHost;
 #endif
 
 cvar_t *sv_cracked;
@@ -23,11 +68,173 @@ cvar_t *g_playerEject;
 cvar_t *sv_allowRcon;
 cvar_t *fs_library;
 cvar_t *sv_downloadMessage;
+cvar_t *sv_scriptProfile;
+cvar_t *sv_statusCacheTime;
+cvar_t *sv_downloadRate;
+cvar_t *sv_downloadBandwidth;
+cvar_t *sv_mapPreload;
+cvar_t *sv_eventLog;
+cvar_t *sv_eventLogMaxSize;
+cvar_t *sv_watchdog;
+cvar_t *sv_metrics;
+cvar_t *sv_shmStats;
+
+#if COMPILE_RATELIMITER == 1 && ( COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+void SVC_RateLimitBenchmark( void );
+void SVC_RateLimitStats( void );
+void SVC_InvalidateStatusCache( void );
+#endif
+
+#if COMPILE_RATELIMITER == 1
+void SVC_RegisterRateLimitCvars( void );
+#endif
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void SV_DownloadStats( void );
+#endif
+
+void manymaps_preload_next();
+void manymaps_preload_report();
+void FS_ClearIwdStaging();
+
+#if COMPILE_METRICS == 1
+void SV_PublishMetrics();
+#endif
+
+#if COMPILE_SHMSTATS == 1
+void SV_UpdateShmStats();
+#endif
 
 #define MAX_MASTER_SERVERS 5
 #define PORT_MASTER 20710
 cvar_t *sv_master[MAX_MASTER_SERVERS];
 
+#if COMPILE_HTTPSERVER == 1 && ( COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+static char httpBaseURL[MAX_STRINGLENGTH]; // sv_wwwBaseURL as set by SV_StartHttpServer
+
+// Serves iwds over HTTP and points wwwDownload at it
+void SV_StartHttpServer(int port)
+{
+	cvar_t *net_ip = Cvar_FindVar("net_ip");
+	cvar_t *sv_wwwBaseURL = Cvar_FindVar("sv_wwwBaseURL");
+
+	const char *bindip = net_ip && strcmp(net_ip->string, "localhost") != 0 ? net_ip->string : "";
+
+	if (!http_server_start(bindip, port))
+		return;
+
+	const char *host = sv_httpHost->string;
+
+	if (!*host && *bindip && strcmp(bindip, "0.0.0.0") != 0)
+		host = bindip;
+
+	if (!*host)
+	{
+		Com_Printf("HTTP download server: set sv_httpHost to the public address so sv_wwwBaseURL can be set\n");
+		return;
+	}
+
+	if (sv_wwwBaseURL != NULL)
+	{
+		char url[MAX_STRINGLENGTH];
+		snprintf(url, sizeof(url), "http://%s:%i", host, port);
+		Cvar_SetString(sv_wwwBaseURL, url);
+		snprintf(httpBaseURL, sizeof(httpBaseURL), "%s", url);
+		Com_Printf("sv_wwwBaseURL set to %s\n", url);
+	}
+}
+
+// Clients are not sent to the stopped server any more, an URL set by the admin stays
+void SV_StopHttpServer()
+{
+	cvar_t *sv_wwwBaseURL = Cvar_FindVar("sv_wwwBaseURL");
+
+	http_server_stop();
+
+	if (sv_wwwBaseURL != NULL && *httpBaseURL && strcmp(sv_wwwBaseURL->string, httpBaseURL) == 0)
+		Cvar_SetString(sv_wwwBaseURL, "");
+
+	*httpBaseURL = '\0';
+}
+#endif
+
+// Services configured by cvars are started from the frame hook, during SV_Init
+// server.cfg has not been executed yet and net_port does not exist
+void SV_UpdateServices()
+{
+#if COMPILE_HTTPSERVER == 1 && ( COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+	static cvar_t *net_port = NULL;
+	static int httpTriedPort = 0; // a port that failed is not retried every frame
+
+	if (sv_httpServer->boolean && !http_server_running())
+	{
+		if (net_port == NULL)
+			net_port = Cvar_FindVar("net_port");
+
+		// TCP can share the game's UDP port number
+		int port = atoi(sv_httpPort->string) > 0 ? atoi(sv_httpPort->string) : (net_port ? net_port->integer : 28960);
+
+		if (port != httpTriedPort)
+		{
+			httpTriedPort = port;
+			SV_StartHttpServer(port);
+		}
+	}
+	else if (!sv_httpServer->boolean && http_server_running())
+	{
+		SV_StopHttpServer();
+		httpTriedPort = 0;
+	}
+#endif
+
+#if COMPILE_EVENTLOG == 1
+	// file name prefix of the logevent() output, sv_eventLogMaxSize is in MB
+	static char eventLogPrefix[MAX_OSPATH];
+	static char eventLogMaxSize[16];
+
+	if (strncmp(sv_eventLog->string, eventLogPrefix, sizeof(eventLogPrefix) - 1) != 0 || strncmp(sv_eventLogMaxSize->string, eventLogMaxSize, sizeof(eventLogMaxSize) - 1) != 0)
+	{
+		snprintf(eventLogPrefix, sizeof(eventLogPrefix), "%s", sv_eventLog->string);
+		snprintf(eventLogMaxSize, sizeof(eventLogMaxSize), "%s", sv_eventLogMaxSize->string);
+
+		if (*eventLogPrefix)
+			event_log_start(eventLogPrefix, atoi(eventLogMaxSize) * 1024 * 1024);
+		else
+			event_log_stop();
+	}
+#endif
+
+#if COMPILE_METRICS == 1
+	// a port on 127.0.0.1 or unix:<path>
+	static char metricsAddress[MAX_OSPATH];
+
+	if (strncmp(sv_metrics->string, metricsAddress, sizeof(metricsAddress) - 1) != 0)
+	{
+		snprintf(metricsAddress, sizeof(metricsAddress), "%s", sv_metrics->string);
+
+		if (*metricsAddress)
+			metrics_start(metricsAddress);
+		else
+			metrics_stop();
+	}
+#endif
+
+#if COMPILE_SHMSTATS == 1
+	// a shared memory name like /cod2_28960
+	static char shmStatsName[MAX_OSPATH];
+
+	if (strncmp(sv_shmStats->string, shmStatsName, sizeof(shmStatsName) - 1) != 0)
+	{
+		snprintf(shmStatsName, sizeof(shmStatsName), "%s", sv_shmStats->string);
+
+		if (*shmStatsName)
+			shm_stats_start(shmStatsName);
+		else
+			shm_stats_stop();
+	}
+#endif
+}
+
 void hook_sv_init(const char *format, ...)
 {
 	char s[MAX_STRINGLENGTH];
@@ -50,6 +257,20 @@ void hook_sv_init(const char *format, ...)
 	sv_allowRcon = Cvar_RegisterBool("sv_allowRcon", qtrue, CVAR_ARCHIVE);
 	fs_library = Cvar_RegisterString("fs_library", "", CVAR_ARCHIVE);
 	sv_downloadMessage = Cvar_RegisterString("sv_downloadMessage", "", CVAR_ARCHIVE);
+	sv_scriptProfile = Cvar_RegisterBool("sv_scriptProfile", qfalse, CVAR_ARCHIVE);
+	sv_statusCacheTime = Cvar_RegisterString("sv_statusCacheTime", "1000", CVAR_ARCHIVE);
+	sv_downloadRate = Cvar_RegisterString("sv_downloadRate", "100000", CVAR_ARCHIVE);
+	sv_downloadBandwidth = Cvar_RegisterString("sv_downloadBandwidth", "0", CVAR_ARCHIVE);
+	sv_mapPreload = Cvar_RegisterBool("sv_mapPreload", qtrue, CVAR_ARCHIVE);
+	sv_eventLog = Cvar_RegisterString("sv_eventLog", "", CVAR_ARCHIVE);
+	sv_eventLogMaxSize = Cvar_RegisterString("sv_eventLogMaxSize", "64", CVAR_ARCHIVE);
+	sv_watchdog = Cvar_RegisterString("sv_watchdog", "0", CVAR_ARCHIVE);
+	sv_metrics = Cvar_RegisterString("sv_metrics", "", CVAR_ARCHIVE);
+	sv_shmStats = Cvar_RegisterString("sv_shmStats", "", CVAR_ARCHIVE);
+
+#if COMPILE_RATELIMITER == 1
+	SVC_RegisterRateLimitCvars();
+#endif
 
 	sv_master[0] = Cvar_RegisterString("sv_master1", "cod2master.activision.com", CVAR_ARCHIVE);
 	sv_master[1] = Cvar_RegisterString("sv_master2", "master.cod2.ru", CVAR_ARCHIVE);
@@ -62,6 +283,25 @@ void hook_sv_init(const char *format, ...)
 
 #if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
 	cl_wwwDownload = Cvar_RegisterBool("cl_wwwDownload", qtrue, CVAR_ARCHIVE | CVAR_SYSTEMINFO);
+
+	sv_httpServer = Cvar_RegisterBool("sv_httpServer", qfalse, CVAR_ARCHIVE);
+	sv_httpPort = Cvar_RegisterString("sv_httpPort", "", CVAR_ARCHIVE);
+	sv_httpHost = Cvar_RegisterString("sv_httpHost", "", CVAR_ARCHIVE);
+#endif
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	// Register custom commands
+	Cmd_AddCommand("scriptprofile", Scr_ProfileCommand);
+	Cmd_AddCommand("downloadstats", SV_DownloadStats);
+
+#if COMPILE_PERFSTATS == 1
+	Cmd_AddCommand("libcod_perf", perf_print);
+#endif
+
+#if COMPILE_RATELIMITER == 1
+	Cmd_AddCommand("ratelimitbench", SVC_RateLimitBenchmark);
+	Cmd_AddCommand("ratelimitstats", SVC_RateLimitStats);
+#endif
 #endif
 
 	sv_maxclients = Cvar_FindVar("sv_maxclients");
@@ -77,6 +317,15 @@ void hook_sv_init(const char *format, ...)
 	sv_wwwDownload = Cvar_FindVar("sv_wwwDownload");
 #endif
 
+#if COMPILE_WATCHDOG == 1
+	// sv_watchdog is the longest allowed gap between server frames in ms, checked while it is set
+	char stallReport[MAX_OSPATH];
+	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
+
+	snprintf(stallReport, sizeof(stallReport), "%s/libcod_stalls.log", fs_homepath ? fs_homepath->string : ".");
+	watchdog_start(stallReport);
+#endif
+
 }
 
 void hook_sv_spawnserver(const char *format, ...)
@@ -92,17 +341,77 @@ void hook_sv_spawnserver(const char *format, ...)
 
 	/* Do stuff after sv has been spawned here */
 
+	FS_ClearIwdStaging();
+
 #if COMPILE_SQLITE == 1
 	free_sqlite_db_stores_and_tasks();
 #endif
 
+#if COMPILE_RATELIMITER == 1 && ( COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+	SVC_InvalidateStatusCache();
+#endif
+
+#if COMPILE_HTTPSERVER == 1 && ( COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+	// fs_game may have changed
+	if (http_server_running())
+		http_server_update_paths();
+#endif
+
+	if (sv_mapPreload->boolean)
+		manymaps_preload_next();
 }
 
 #define	HEARTBEAT_MSEC	180000
 #define	STATUS_MSEC		600000
+// Returns 1 when adr holds the address of master i
+static int SV_ResolveMaster(int i, netadr_t *adr)
+{
+#if COMPILE_RESOLVER == 1
+	// never blocks, a master still being looked up is retried on the next frame
+	int result = net_resolve_cached( sv_master[i]->string, adr, PORT_MASTER );
+
+	if ( result == RESOLVE_PENDING )
+		return 0;
+
+	if ( result == RESOLVE_FAILED )
+		return -1;
+
+	return 1;
+#else
+	// see if we haven't already resolved the name
+	// do it when needed
+	if ( sv_master[i]->modified || !adr->type )
+	{
+		sv_master[i]->modified = qfalse;
+
+		Com_Printf( "Resolving %s\n", sv_master[i]->string );
+		if ( !NET_StringToAdr( sv_master[i]->string, adr ) )
+		{
+			// if the address failed to resolve, clear it
+			// so we don't take repeated dns hits
+			Com_Printf( "Couldn't resolve address: %s\n", sv_master[i]->string );
+			Cvar_SetString(sv_master[i], "");
+			sv_master[i]->modified = qfalse;
+			return -1;
+		}
+		if ( !strstr( ":", sv_master[i]->string ) )
+		{
+			adr->port = BigShort( PORT_MASTER );
+		}
+		Com_Printf( "%s resolved to %i.%i.%i.%i:%i\n", sv_master[i]->string,
+		            adr->ip[0], adr->ip[1], adr->ip[2], adr->ip[3],
+		            BigShort( adr->port ) );
+	}
+
+	return 1;
+#endif
+}
+
 void custom_SV_MasterHeartbeat(const char *game)
 {
 	static netadr_t	adr[MAX_MASTER_SERVERS];
+	static bool heartbeatPending[MAX_MASTER_SERVERS];
+	static bool statusPending[MAX_MASTER_SERVERS];
 	char heartbeat[32];
 	int	i;
 
@@ -111,51 +420,15 @@ void custom_SV_MasterHeartbeat(const char *game)
 		return;	// only dedicated servers send heartbeats
 	}
 
+	PERF_BEGIN(perfStart);
+
 	// if not time yet, don't send anything
 	if ( svs.time >= svs.nextHeartbeatTime )
 	{
 		svs.nextHeartbeatTime = svs.time + HEARTBEAT_MSEC;
 
-		// send to group masters
 		for ( i = 0 ; i < MAX_MASTER_SERVERS ; i++ )
-		{
-			if ( !sv_master[i]->string[0] )
-			{
-				continue;
-			}
-
-			// see if we haven't already resolved the name
-			// do it when needed
-			if ( sv_master[i]->modified || !adr[i].type )
-			{
-				sv_master[i]->modified = qfalse;
-
-				Com_Printf( "Resolving %s\n", sv_master[i]->string );
-				if ( !NET_StringToAdr( sv_master[i]->string, &adr[i] ) )
-				{
-					// if the address failed to resolve, clear it
-					// so we don't take repeated dns hits
-					Com_Printf( "Couldn't resolve address: %s\n", sv_master[i]->string );
-					Cvar_SetString(sv_master[i], "");
-					sv_master[i]->modified = qfalse;
-					continue;
-				}
-				if ( !strstr( ":", sv_master[i]->string ) )
-				{
-					adr[i].port = BigShort( PORT_MASTER );
-				}
-				Com_Printf( "%s resolved to %i.%i.%i.%i:%i\n", sv_master[i]->string,
-				            adr[i].ip[0], adr[i].ip[1], adr[i].ip[2], adr[i].ip[3],
-				            BigShort( adr[i].port ) );
-			}
-
-			if (strlen(sv_master[i]->string))
-			{
-				Com_Printf( "Sending heartbeat to %s\n", sv_master[i]->string );
-				sprintf(heartbeat, "heartbeat %s\n", game);
-				NET_OutOfBandPrint( NS_SERVER, adr[i], heartbeat );
-			}
-		}
+			heartbeatPending[i] = true;
 	}
 
 	// if not time yet, don't send anything
@@ -163,43 +436,47 @@ void custom_SV_MasterHeartbeat(const char *game)
 	{
 		svs.nextStatusResponseTime = svs.time + STATUS_MSEC;
 
-		// send to group masters
 		for ( i = 0 ; i < MAX_MASTER_SERVERS ; i++ )
+			statusPending[i] = true;
+	}
+
+	// send to group masters, the ones still resolving get it on a later frame
+	for ( i = 0 ; i < MAX_MASTER_SERVERS ; i++ )
+	{
+		if ( !heartbeatPending[i] && !statusPending[i] )
 		{
-			if ( !sv_master[i]->string[0] )
-			{
-				continue;
-			}
+			continue;
+		}
 
-			// see if we haven't already resolved the name
-			// do it when needed
-			if ( sv_master[i]->modified || !adr[i].type )
-			{
-				sv_master[i]->modified = qfalse;
+		if ( !sv_master[i]->string[0] )
+		{
+			heartbeatPending[i] = false;
+			statusPending[i] = false;
+			continue;
+		}
 
-				Com_Printf( "Resolving %s\n", sv_master[i]->string );
-				if ( !NET_StringToAdr( sv_master[i]->string, &adr[i] ) )
-				{
-					// if the address failed to resolve, clear it
-					// so we don't take repeated dns hits
-					Com_Printf( "Couldn't resolve address: %s\n", sv_master[i]->string );
-					Cvar_SetString(sv_master[i], "");
-					sv_master[i]->modified = qfalse;
-					continue;
-				}
-				if ( !strstr( ":", sv_master[i]->string ) )
-				{
-					adr[i].port = BigShort( PORT_MASTER );
-				}
-				Com_Printf( "%s resolved to %i.%i.%i.%i:%i\n", sv_master[i]->string,
-				            adr[i].ip[0], adr[i].ip[1], adr[i].ip[2], adr[i].ip[3],
-				            BigShort( adr[i].port ) );
-			}
+		int resolved = SV_ResolveMaster( i, &adr[i] );
 
-			if (strlen(sv_master[i]->string))
-				SVC_Status(adr[i]);
+		if ( resolved == 0 )
+		{
+			continue;
+		}
+
+		if ( resolved > 0 && heartbeatPending[i] )
+		{
+			Com_Printf( "Sending heartbeat to %s\n", sv_master[i]->string );
+			sprintf(heartbeat, "heartbeat %s\n", game);
+			NET_OutOfBandPrint( NS_SERVER, adr[i], heartbeat );
 		}
+
+		if ( resolved > 0 && statusPending[i] )
+			SVC_Status(adr[i]);
+
+		heartbeatPending[i] = false;
+		statusPending[i] = false;
 	}
+
+	PERF_END(PERF_HEARTBEAT, perfStart);
 }
 
 int codecallback_remotecommand = 0;
@@ -216,8 +493,6 @@ int codecallback_attackbutton = 0;
 cHook *hook_gametype_scripts;
 int hook_codscript_gametype_scripts()
 {
-	hook_gametype_scripts->unhook();
-
 	codecallback_remotecommand = Scr_GetFunctionHandle("maps/mp/gametypes/_callbacksetup", "CodeCallback_RemoteCommand", 0);
 
 	codecallback_playercommand = Scr_GetFunctionHandle("maps/mp/gametypes/_callbacksetup", "CodeCallback_PlayerCommand", 0);
@@ -230,9 +505,8 @@ int hook_codscript_gametype_scripts()
 	codecallback_attackbutton = Scr_GetFunctionHandle("maps/mp/gametypes/_callbacksetup", "CodeCallback_AttackButton", 0);
 
 	int (*sig)();
-	*(int *)&sig = hook_gametype_scripts->from;
+	*(int *)&sig = hook_gametype_scripts->trampoline;
 	int ret = sig();
-	hook_gametype_scripts->hook();
 
 	return ret;
 }
@@ -241,10 +515,8 @@ int player_disableitempickup[MAX_CLIENTS] = {0};
 cHook *hook_touch_item_auto;
 int touch_item_auto(gentity_t *ent, gentity_t *other, int touch)
 {
-	hook_touch_item_auto->unhook();
-
 	int (*sig)(gentity_t *ent, gentity_t *other, int touch);
-	*(int *)&sig = hook_touch_item_auto->from;
+	*(int *)&sig = hook_touch_item_auto->trampoline;
 
 	int ret;
 
@@ -253,18 +525,14 @@ int touch_item_auto(gentity_t *ent, gentity_t *other, int touch)
 	else
 		ret = 0;
 
-	hook_touch_item_auto->hook();
-
 	return ret;
 }
 
 cHook *hook_player_collision;
 int player_collision(int a1)
 {
-	hook_player_collision->unhook();
-
 	int (*sig)(int a1);
-	*(int *)&sig = hook_player_collision->from;
+	*(int *)&sig = hook_player_collision->trampoline;
 
 	int ret;
 
@@ -273,18 +541,14 @@ int player_collision(int a1)
 	else
 		ret = 0;
 
-	hook_player_collision->hook();
-
 	return ret;
 }
 
 cHook *hook_player_eject;
 int player_eject(int a1)
 {
-	hook_player_eject->unhook();
-
 	int (*sig)(int a1);
-	*(int *)&sig = hook_player_eject->from;
+	*(int *)&sig = hook_player_eject->trampoline;
 
 	int ret;
 
@@ -293,23 +557,17 @@ int player_eject(int a1)
 	else
 		ret = 0;
 
-	hook_player_eject->hook();
-
 	return ret;
 }
 
 cHook *hook_fire_grenade;
 gentity_t* fire_grenade(gentity_t *self, vec3_t start, vec3_t dir, int weapon, int time)
 {
-	hook_fire_grenade->unhook();
-
 	gentity_t* (*sig)(gentity_t *self, vec3_t start, vec3_t dir, int weapon, int time);
-	*(int *)&sig = hook_fire_grenade->from;
+	*(int *)&sig = hook_fire_grenade->trampoline;
 
 	gentity_t* grenade = sig(self, start, dir, weapon, time);
 
-	hook_fire_grenade->hook();
-
 	if (codecallback_fire_grenade)
 	{
 		WeaponDef_t *def = BG_WeaponDefs(weapon);
@@ -326,13 +584,17 @@ void hook_ClientCommand(int clientNum)
 {
 	if ( ! codecallback_playercommand)
 	{
+		PERF_BEGIN(perfStart);
 		ClientCommand(clientNum);
+		PERF_END(PERF_COMMANDS, perfStart);
 		return;
 	}
 
 	if (!Scr_IsSystemActive())
 		return;
 
+	PERF_BEGIN(perfStart);
+
 	stackPushArray();
 	int args = Cmd_Argc();
 	for (int i = 0; i < args; i++)
@@ -356,8 +618,12 @@ void hook_ClientCommand(int clientNum)
 		}
 	}
 
+	PERF_BEGIN(scriptStart);
 	short ret = Scr_ExecEntThread(&g_entities[clientNum], codecallback_playercommand, 1);
 	Scr_FreeThread(ret);
+	PERF_END(PERF_SCRIPT, scriptStart);
+
+	PERF_END(PERF_COMMANDS, perfStart);
 }
 
 int hook_isLanAddress(netadr_t adr)
@@ -380,6 +646,11 @@ const char* hook_AuthorizeState(int arg)
 
 void hook_ClientUserinfoChanged(int clientNum)
 {
+#if COMPILE_RATELIMITER == 1 && ( COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+	// Names are part of the cached getstatus response
+	SVC_InvalidateStatusCache();
+#endif
+
 	if ( ! codecallback_userinfochanged)
 	{
 		ClientUserinfoChanged(clientNum);
@@ -394,790 +665,2434 @@ void hook_ClientUserinfoChanged(int clientNum)
 	Scr_FreeThread(ret);
 }
 
-void custom_SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
+#define MAX_DOWNLOAD_MAPPINGS 16
+
+// Read-only mapping of a downloaded file, shared by every client downloading it
+typedef struct
 {
-	int curindex;
-	int iwdFile;
-	char errorMessage[MAX_STRINGLENGTH];
+	char path[MAX_OSPATH];
+	unsigned char *data;
+	int size;
+	int refs;
+	int fd; // kept open for the read-ahead thread
+	int ioBusy; // read-ahead calls in progress, the mapping is closed after them
+} downloadMapping_t;
 
-	if (cl->state == CS_ACTIVE)
-		return; // Client already in game
+static downloadMapping_t downloadMappings[MAX_DOWNLOAD_MAPPINGS];
+static downloadMapping_t *clientDownloadMappings[MAX_CLIENTS];
 
-	if (!*cl->downloadName)
-		return;	// Nothing being downloaded
+#define DOWNLOAD_READAHEAD ( 256 * 1024 )
 
-	if (strlen(cl->downloadName) < 4)
-		return; // File length too short
+// Region of a mapping a client will send next, read into the page cache by the read-ahead thread
+typedef struct
+{
+	downloadMapping_t *mapping;
+	int offset;
+	int length;
+	bool pending;
+} downloadPrefetch_t;
+
+static downloadPrefetch_t downloadPrefetches[MAX_CLIENTS];
+static pthread_mutex_t downloadMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t downloadCond = PTHREAD_COND_INITIALIZER;
+static bool downloadThreadStarted = false;
+
+#define DOWNLOAD_MIN_TIMEOUT 100
+#define DOWNLOAD_MAX_TIMEOUT 1000
+
+// Congestion control of a download, the window never exceeds MAX_DOWNLOAD_WINDOW
+// because the engine finds the EOF block in downloadBlockSize when it is acknowledged
+typedef struct
+{
+	int window; // blocks allowed in flight
+	int acked; // acknowledged blocks towards the next window increase
+	int lastClientBlock;
+	int highestXmitBlock;
+	int srtt; // smoothed round trip time of a block in ms, 0 until measured
+	int rttvar;
+	int blockSendTime[MAX_DOWNLOAD_WINDOW];
+	bool blockResent[MAX_DOWNLOAD_WINDOW];
+	int startTime;
+	int bytesSent;
+	int retransmits;
+	int deficit; // bytes this client may still send under sv_downloadBandwidth
+	int demand; // bytes its window could take in the last round
+	int granted; // bytes given to it in the last round
+	int share; // granted as bytes per second
+} downloadState_t;
+
+static downloadState_t downloadStates[MAX_CLIENTS];
+static int downloadScheduleTime;
+static int downloadRoundStart; // client the next round starts with
+static int downloadClients;
+static unsigned int downloadBytesTotal;
+
+static int SV_DownloadTimeout(downloadState_t *state)
+{
+	if (!state->srtt)
+		return DOWNLOAD_MAX_TIMEOUT;
 
-	if (strcmp(&cl->downloadName[strlen(cl->downloadName) - 4], ".iwd") != 0)
-		return; // Not a iwd file
+	int timeout = state->srtt + 4 * state->rttvar;
 
-#if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
-	if ( cl->wwwDlAck )
-		return; // wwwDl acknowleged
-#endif
+	if (timeout < DOWNLOAD_MIN_TIMEOUT)
+		return DOWNLOAD_MIN_TIMEOUT;
 
-	if (strlen(sv_downloadMessage->string))
-	{
-		Com_sprintf(errorMessage, sizeof(errorMessage), sv_downloadMessage->string);
+	if (timeout > DOWNLOAD_MAX_TIMEOUT)
+		return DOWNLOAD_MAX_TIMEOUT;
 
-		MSG_WriteByte( msg, svc_download );
-		MSG_WriteShort( msg, 0 ); // client is expecting block zero
-		MSG_WriteLong( msg, -1 ); // illegal file size
-		MSG_WriteString( msg, errorMessage );
+	return timeout;
+}
 
-		*cl->downloadName = 0;
-		return; // Download message instead of download
-	}
+static void SV_DownloadAcknowledged(client_t *cl, downloadState_t *state)
+{
+	int acked = cl->downloadClientBlock - state->lastClientBlock;
 
-#if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
-	if (sv_wwwDownload->boolean && cl->wwwDownload)
+	if (acked <= 0)
+		return;
+
+	state->lastClientBlock = cl->downloadClientBlock;
+
+	// Measure the round trip on the newest acknowledged block, resent blocks are ambiguous
+	int index = (cl->downloadClientBlock - 1) % MAX_DOWNLOAD_WINDOW;
+
+	if (!state->blockResent[index])
 	{
-		if (!cl->wwwDl_failed)
+		int sample = svs.time - state->blockSendTime[index];
+
+		if (sample < 1)
+			sample = 1;
+
+		if (!state->srtt)
 		{
-			SV_WWWRedirectClient(cl, msg);
-			return; // wwwDl redirect
+			state->srtt = sample;
+			state->rttvar = sample / 2;
+		}
+		else
+		{
+			state->rttvar = (3 * state->rttvar + abs(state->srtt - sample)) / 4;
+			state->srtt = (7 * state->srtt + sample) / 8;
 		}
 	}
-#endif
 
-	// Hardcode client variables to make max download speed for everyone
-	cl->state = CS_CONNECTED;
-	cl->rate = 25000;
-	cl->snapshotMsec = 50;
+	// Additive increase, one block per acknowledged window
+	state->acked += acked;
 
-	if (!cl->download)
+	while (state->acked >= state->window)
 	{
-		// We open the file here
+		state->acked -= state->window;
 
-		Com_Printf("clientDownload: %d : begining \"%s\"\n", cl - svs.clients, cl->downloadName);
+		if (state->window < MAX_DOWNLOAD_WINDOW)
+			state->window++;
+	}
+}
 
-		iwdFile = FS_iwIwd(cl->downloadName, "main");
+// Bytes a client could put on the wire this frame: the room left in its window, or
+// a whole window when a resend is due. Blocks count as full except at the end of the file.
+static int SV_DownloadDemand(client_t *cl, downloadState_t *state)
+{
+	int first = cl->downloadXmitBlock;
+	int blocks = state->window - (cl->downloadXmitBlock - cl->downloadClientBlock);
 
-		if ( !sv_allowDownload->integer || iwdFile || ( cl->downloadSize = FS_SV_FOpenFileRead( cl->downloadName, &cl->download ) ) <= 0 )
-		{
-			// cannot auto-download file
-			if (iwdFile)
-			{
-				Com_Printf("clientDownload: %d : \"%s\" cannot download iwd files\n", cl - svs.clients, cl->downloadName);
-				Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_CANTAUTODLGAMEIWD\x15%s", cl->downloadName);
-			}
-			else if ( !sv_allowDownload->boolean )
-			{
-				Com_Printf("clientDownload: %d : \"%s\" download disabled\n", cl - svs.clients, cl->downloadName);
+	if (blocks <= 0 || (cl->downloadEOF && cl->downloadXmitBlock == cl->downloadCurrentBlock))
+	{
+		if (svs.time - cl->downloadSendTime <= SV_DownloadTimeout(state))
+			return 0; // waiting for acknowledgements
 
-				if (sv_pure->boolean)
-					Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_SERVERDISABLED_PURE\x15%s", cl->downloadName);
-				else
-					Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_SERVERDISABLED\x15%s", cl->downloadName);
-			}
-			else
-			{
-				Com_Printf("clientDownload: %d : \"%s\" file not found on server\n", cl - svs.clients, cl->downloadName);
-				Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_FILENOTONSERVER\x15%s", cl->downloadName);
-			}
+		first = cl->downloadClientBlock;
+		blocks = state->window;
+	}
 
-			MSG_WriteByte( msg, svc_download );
-			MSG_WriteShort( msg, 0 ); // client is expecting block zero
-			MSG_WriteLong( msg, -1 ); // illegal file size
-			MSG_WriteString( msg, errorMessage );
+	int remaining = cl->downloadSize - first * MAX_DOWNLOAD_BLKSIZE;
 
-			*cl->downloadName = 0;
-			return;
-		}
+	if (remaining < 0)
+		remaining = 0;
 
-		// Init
-		cl->downloadCurrentBlock = cl->downloadClientBlock = cl->downloadXmitBlock = 0;
-		cl->downloadCount = 0;
-		cl->downloadEOF = qfalse;
+	return blocks * MAX_DOWNLOAD_BLKSIZE < remaining ? blocks * MAX_DOWNLOAD_BLKSIZE : remaining;
+}
+
+// Deficit round robin over the downloading clients. Every server frame each one gets
+// a quantum of sv_downloadBandwidth, a client whose window has no room for it hands the
+// rest back and a second pass gives that to clients that still have blocks waiting.
+// The round starts one client further every frame so leftovers rotate.
+// Snapshots are never held back, only the download blocks riding along with them.
+void SV_ScheduleDownloads()
+{
+	int bandwidth = atoi(sv_downloadBandwidth->string);
+	int elapsed = svs.time - downloadScheduleTime;
+	int maxclients = sv_maxclients->integer < MAX_CLIENTS ? sv_maxclients->integer : MAX_CLIENTS;
+	int i, n;
+
+	downloadScheduleTime = svs.time;
+	downloadClients = 0;
+
+	for (i = 0; i < maxclients; i++)
+	{
+		if (svs.clients[i].download)
+			downloadClients++;
+		else
+			downloadStates[i].deficit = 0; // idle clients do not bank a quantum
 	}
 
-	// Perform any reads that we need to
-	while (cl->downloadCurrentBlock - cl->downloadClientBlock < MAX_DOWNLOAD_WINDOW && cl->downloadSize != cl->downloadCount)
+	if (bandwidth <= 0 || !downloadClients || elapsed <= 0)
+		return;
+
+	if (elapsed > 1000)
+		elapsed = 1000;
+
+	int budget = (int)((long long)bandwidth * elapsed / 1000);
+	int quantum = budget / downloadClients;
+	int leftover = budget - quantum * downloadClients;
+
+	if (downloadRoundStart >= maxclients)
+		downloadRoundStart = 0;
+
+	for (n = 0; n < maxclients; n++)
 	{
-		curindex = (cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW);
+		i = (downloadRoundStart + n) % maxclients;
 
-		if (!cl->downloadBlocks[curindex])
-			cl->downloadBlocks[curindex] = (unsigned char *)Z_MallocInternal(MAX_DOWNLOAD_BLKSIZE);
+		client_t *cl = &svs.clients[i];
+		downloadState_t *state = &downloadStates[i];
 
-		cl->downloadBlockSize[curindex] = FS_Read( cl->downloadBlocks[curindex], MAX_DOWNLOAD_BLKSIZE, cl->download );
+		if (!cl->download)
+			continue;
 
-		if (cl->downloadBlockSize[curindex] < 0)
+		state->demand = SV_DownloadDemand(cl, state);
+		state->granted = quantum;
+		state->deficit += quantum;
+
+		// an empty queue keeps no deficit, the unused part goes to the others
+		if (state->deficit > state->demand)
 		{
-			// EOF right now
-			cl->downloadCount = cl->downloadSize;
-			break;
+			state->granted -= state->deficit - state->demand;
+			leftover += state->deficit - state->demand;
+			state->deficit = state->demand;
 		}
+	}
 
-		cl->downloadCount += cl->downloadBlockSize[curindex];
+	for (n = 0; n < maxclients && leftover > 0; n++)
+	{
+		i = (downloadRoundStart + n) % maxclients;
 
-		// Load in next block
-		cl->downloadCurrentBlock++;
+		downloadState_t *state = &downloadStates[i];
+
+		if (!svs.clients[i].download || state->deficit >= state->demand)
+			continue;
+
+		int extra = state->demand - state->deficit < leftover ? state->demand - state->deficit : leftover;
+
+		state->granted += extra;
+		state->deficit += extra;
+		leftover -= extra;
 	}
 
-	// Check to see if we have eof condition and add the EOF block
-	if (cl->downloadCount == cl->downloadSize && !cl->downloadEOF && cl->downloadCurrentBlock - cl->downloadClientBlock < MAX_DOWNLOAD_WINDOW)
+	for (i = 0; i < maxclients; i++)
 	{
-		cl->downloadBlockSize[cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW] = 0;
-		cl->downloadCurrentBlock++;
-		cl->downloadEOF = qtrue;  // We have added the EOF block
+		if (svs.clients[i].download)
+			downloadStates[i].share = (int)((long long)downloadStates[i].granted * 1000 / elapsed);
 	}
 
-	// Write out the next section of the file, if we have already reached our window,
-	// automatically start retransmitting
+	downloadRoundStart++;
+}
 
-	if (cl->downloadClientBlock == cl->downloadCurrentBlock)
-		return; // Nothing to transmit
+static bool SV_DownloadBudgetAllows(downloadState_t *state, int bytes)
+{
+	if (atoi(sv_downloadBandwidth->string) <= 0)
+		return true;
 
-	if (cl->downloadXmitBlock == cl->downloadCurrentBlock)
-	{
-		// We have transmitted the complete window, should we start resending?
+	return state->deficit >= bytes;
+}
 
-		//FIXME:  This uses a hardcoded one second timeout for lost blocks
-		//the timeout should be based on client rate somehow
-		if (svs.time - cl->downloadSendTime > 1000)
-			cl->downloadXmitBlock = cl->downloadClientBlock;
-		else
-			return;
-	}
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void SV_DownloadStats( void )
+{
+	int i;
+	int bandwidth = atoi(sv_downloadBandwidth->string);
 
-	// Send current block
-	curindex = (cl->downloadXmitBlock % MAX_DOWNLOAD_WINDOW);
+	if (bandwidth > 0)
+		Com_Printf("download bandwidth %i B/s shared by %i clients\n", bandwidth, downloadClients);
+	else
+		Com_Printf("download bandwidth unlimited, %i clients\n", downloadClients);
 
-	MSG_WriteByte( msg, svc_download );
-	MSG_WriteShort( msg, cl->downloadXmitBlock );
+	Com_Printf("num name                  block/total  window   rtt    KB/s  share deficit resent file\n");
 
-	// block zero is special, contains file size
-	if ( cl->downloadXmitBlock == 0 )
-		MSG_WriteLong( msg, cl->downloadSize );
+	for (i = 0; i < sv_maxclients->integer; i++)
+	{
+		client_t *cl = &svs.clients[i];
+		downloadState_t *state = &downloadStates[i];
 
-	MSG_WriteShort( msg, cl->downloadBlockSize[curindex] );
+		if (!cl->download)
+			continue;
 
-	// Write the block
-	if ( cl->downloadBlockSize[curindex] )
-		MSG_WriteData( msg, cl->downloadBlocks[curindex], cl->downloadBlockSize[curindex] );
+		int elapsed = svs.time - state->startTime;
 
-	Com_DPrintf("clientDownload: %d : writing block %d\n", cl - svs.clients, cl->downloadXmitBlock);
+		Com_Printf("%3i %-20.20s %6i/%-6i %6i %5i %7.1f %6i %7i %6i %s\n", i, cl->name, cl->downloadClientBlock,
+		           cl->downloadSize / MAX_DOWNLOAD_BLKSIZE + 1, state->window, state->srtt,
+		           elapsed > 0 ? state->bytesSent / 1.024 / elapsed : 0.0, bandwidth > 0 ? state->share / 1024 : 0,
+		           state->deficit, state->retransmits, cl->downloadName);
+	}
+}
+#endif
 
-	// Move on to the next block
-	// It will get sent with next snap shot.  The rate will keep us in line.
-	cl->downloadXmitBlock++;
+// Called with downloadMutex held
+static void SV_UnmapDownload(downloadMapping_t *mapping)
+{
+	munmap(mapping->data, mapping->size);
+	close(mapping->fd);
 
-	cl->downloadSendTime = svs.time;
+	mapping->data = NULL;
+	mapping->fd = -1;
 }
 
-// Segfault fix
-int hook_BG_IsWeaponValid(int a1, int a2)
+static void *SV_DownloadReadAheadThread(void *unused)
 {
-	if ( !(unsigned char)sub_80E9758(a2) )
-		return 0;
+	pthread_mutex_lock(&downloadMutex);
 
-	if ( !(unsigned char)sub_80D9E84(a1 + 1348, a2) )
-		return 0;
+	while (true)
+	{
+		downloadPrefetch_t prefetch;
+		int i;
 
-	int weapon = (int)BG_WeaponDefs(a2);
+		for (i = 0; i < MAX_CLIENTS; i++)
+		{
+			if (downloadPrefetches[i].pending)
+				break;
+		}
 
-	if ( !weapon )
-		return 0;
+		if (i == MAX_CLIENTS)
+		{
+			pthread_cond_wait(&downloadCond, &downloadMutex);
+			continue;
+		}
 
-	if ( !*(long *)(weapon + 132) && *(char *)(a1 + 1365) != a2 && *(char *)(a1 + 1366) != a2 && *(long *)(weapon + 876) != a2 )
-		return 0;
+		prefetch = downloadPrefetches[i];
+		downloadPrefetches[i].pending = false;
+		prefetch.mapping->ioBusy++;
 
-	return 1;
+		pthread_mutex_unlock(&downloadMutex);
+
+		// blocks until the region is in the page cache, the game thread never waits on the disk
+		posix_fadvise(prefetch.mapping->fd, prefetch.offset, prefetch.length, POSIX_FADV_WILLNEED);
+		readahead(prefetch.mapping->fd, prefetch.offset, prefetch.length);
+
+		pthread_mutex_lock(&downloadMutex);
+
+		if (--prefetch.mapping->ioBusy == 0 && prefetch.mapping->refs == 0 && prefetch.mapping->data != NULL)
+			SV_UnmapDownload(prefetch.mapping);
+	}
+
+	return NULL;
 }
 
-char *custom_va(const char *format, ...)
+static void SV_PrefetchDownload(int clientNum, downloadMapping_t *mapping, int offset, bool force)
 {
-	char *s;
-	va_list va;
-	int v1;
-	signed int v3;
+	int length = mapping->size - offset;
 
-	v1 = Sys_GetValue(1);
-	s = (char *)(v1 + (*(int *)(v1 + 2048) << 10));
-	v3 = *(int *)(v1 + 2048) + 1;
-	*(int *)(v1 + 2048) = v3 / 2;
-	*(int *)(v1 + 2048) = v3 - 2 * *(int *)(v1 + 2048);
+	if (length <= 0)
+		return;
 
-	va_start(va, format);
-	vsnprintf(s, MAX_STRINGLENGTH, format, va);
-	va_end(va);
+	if (length > DOWNLOAD_READAHEAD)
+		length = DOWNLOAD_READAHEAD;
 
-	s[MAX_STRINGLENGTH - 1] = '\0';
+	pthread_mutex_lock(&downloadMutex);
 
-	return s;
-}
+	downloadPrefetch_t *prefetch = &downloadPrefetches[clientNum];
 
-void hook_SV_VerifyIwds_f(client_t *cl)
-{
-	if (sv_pure->boolean)
-		cl->pureAuthentic = 1;
+	// ask again once the client is halfway through the last region
+	if (force || prefetch->mapping != mapping || offset < prefetch->offset || offset >= prefetch->offset + prefetch->length / 2)
+	{
+		prefetch->mapping = mapping;
+		prefetch->offset = offset;
+		prefetch->length = length;
+		prefetch->pending = true;
+
+		pthread_cond_signal(&downloadCond);
+	}
+
+	pthread_mutex_unlock(&downloadMutex);
 }
 
-void hook_SV_ResetPureClient_f(client_t *cl)
+static bool SV_DownloadBlockResident(downloadMapping_t *mapping, int offset, int length)
 {
-	cl->pureAuthentic = 0;
+	static long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned char resident[4];
 
-	if (codecallback_vid_restart)
-	{
-		if (!Scr_IsSystemActive())
-			return;
+	unsigned long start = (unsigned long)(mapping->data + offset) & ~(pageSize - 1);
+	unsigned long end = (unsigned long)(mapping->data + offset + length);
+	int pages = (end - start + pageSize - 1) / pageSize;
 
-		if (cl->gentity == NULL)
-			return;
+	if (pages > (int)sizeof(resident) || mincore((void *)start, end - start, resident) != 0)
+		return true; // can not tell, copy anyway
 
-		stackPushInt(cl - svs.clients);
-		short ret = Scr_ExecEntThread(cl->gentity, codecallback_vid_restart, 1);
-		Scr_FreeThread(ret);
+	for (int i = 0; i < pages; i++)
+	{
+		if (!(resident[i] & 1))
+			return false;
 	}
+
+	return true;
 }
 
-// Adds bot pings and removes spam on 1.2 and 1.3
-void custom_SV_CalcPings( void )
+static downloadMapping_t *SV_AcquireDownloadMapping(const char *filename, int size)
 {
-	int i, j;
-	client_t *cl;
-	int total, count;
-	int delta;
+	const char *basepaths[] = { "fs_homepath", "fs_basepath" };
+	char path[MAX_OSPATH];
+	struct stat st;
+	int i;
 
-	for ( i = 0 ; i < sv_maxclients->integer ; i++ )
+	// Same search order as FS_SV_FOpenFileRead, the size tells it is the file the engine opened
+	for (i = 0; i < 2; i++)
 	{
-		cl = &svs.clients[i];
+		cvar_t *basepath = Cvar_FindVar(basepaths[i]);
 
-		if ( cl->state != CS_ACTIVE )
-		{
-			cl->ping = -1;
+		if (basepath == NULL || !*basepath->string)
 			continue;
-		}
 
-		if ( !cl->gentity )
-		{
-			cl->ping = -1;
-			continue;
-		}
+		snprintf(path, sizeof(path), "%s/%s", basepath->string, filename);
 
-		if ( cl->netchan.remoteAddress.type == NA_BOT )
-		{
-			cl->ping = 0;
-			cl->lastPacketTime = svs.time;
-			continue;
-		}
+		if (stat(path, &st) == 0 && st.st_size == size)
+			break;
+	}
 
-		total = 0;
-		count = 0;
+	if (i == 2)
+		return NULL;
 
-		for ( j = 0 ; j < PACKET_BACKUP ; j++ )
-		{
-			if ( cl->frames[j].messageAcked == 0xFFFFFFFF )
-				continue;
+	pthread_mutex_lock(&downloadMutex);
 
-			delta = cl->frames[j].messageAcked - cl->frames[j].messageSent;
-			count++;
-			total += delta;
-		}
+	if (!downloadThreadStarted)
+	{
+		pthread_t readahead_thread;
 
-		if ( !count )
-			cl->ping = 999;
-		else
+		if (pthread_create(&readahead_thread, NULL, SV_DownloadReadAheadThread, NULL) != 0 || pthread_detach(readahead_thread) != 0)
 		{
-			cl->ping = total / count;
-
-			if ( cl->ping > 999 )
-				cl->ping = 999;
+			pthread_mutex_unlock(&downloadMutex);
+			Com_Printf("clientDownload: error creating read-ahead thread!\n");
+			return NULL;
 		}
-	}
-}
 
-void custom_SV_CheckTimeouts( void )
-{
-	int	i;
-	client_t *cl;
-	int	droppoint;
-	int	zombiepoint;
+		downloadThreadStarted = true;
+	}
 
-	droppoint = svs.time - 1000 * sv_timeout->integer;
-	zombiepoint = svs.time - 1000 * sv_zombietime->integer;
+	downloadMapping_t *unused = NULL;
 
-	for ( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	for (i = 0; i < MAX_DOWNLOAD_MAPPINGS; i++)
 	{
-		// message times may be wrong across a changelevel
-		if (cl->lastPacketTime > svs.time)
-			cl->lastPacketTime = svs.time;
+		downloadMapping_t *mapping = &downloadMappings[i];
 
-		if (cl->state == CS_ZOMBIE && cl->lastPacketTime < zombiepoint)
+		if (mapping->refs > 0 && mapping->size == size && strcmp(mapping->path, path) == 0)
 		{
-			cl->state = CS_FREE; // can now be reused
-			continue;
+			mapping->refs++;
+			pthread_mutex_unlock(&downloadMutex);
+			return mapping;
 		}
 
-		if (cl->state >= CS_CONNECTED && cl->lastPacketTime < droppoint)
-		{
-			// wait several frames so a debugger session doesn't
-			// cause a timeout
-			if ( ++cl->timeoutCount > 5 )
-			{
-				SV_DropClient(cl, "EXE_TIMEDOUT");
-				cl->state = CS_FREE; // don't bother with zombie state
-			}
-		}
-		else
-			cl->timeoutCount = 0;
+		// mappings still in use by the read-ahead thread are closed by it
+		if (mapping->refs == 0 && mapping->data == NULL && unused == NULL)
+			unused = mapping;
+	}
+
+	int fd = unused != NULL ? open(path, O_RDONLY) : -1;
+
+	if (fd < 0)
+	{
+		pthread_mutex_unlock(&downloadMutex);
+		return NULL;
+	}
+
+	void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		pthread_mutex_unlock(&downloadMutex);
+		return NULL;
 	}
+
+	madvise(data, size, MADV_SEQUENTIAL);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	Com_DPrintf("clientDownload: mapped \"%s\"\n", path);
+
+	strncpy(unused->path, path, sizeof(unused->path) - 1);
+	unused->path[sizeof(unused->path) - 1] = '\0';
+	unused->data = (unsigned char *)data;
+	unused->size = size;
+	unused->refs = 1;
+	unused->fd = fd;
+	unused->ioBusy = 0;
+
+	pthread_mutex_unlock(&downloadMutex);
+
+	return unused;
 }
 
-#if COMPILE_BOTS == 1
-int bot_buttons[MAX_CLIENTS] = {0};
-int bot_weapon[MAX_CLIENTS] = {0};
-char bot_forwardmove[MAX_CLIENTS] = {0};
-char bot_rightmove[MAX_CLIENTS] = {0};
-void custom_SV_BotUserMove(client_t *client)
+static void SV_ReleaseDownloadMapping(int clientNum)
 {
-	int num;
-	usercmd_t ucmd = {0};
+	downloadMapping_t *mapping = clientDownloadMappings[clientNum];
 
-	if (client->gentity == NULL)
+	if (mapping == NULL)
 		return;
 
-	num = client - svs.clients;
-	ucmd.serverTime = svs.time;
+	clientDownloadMappings[clientNum] = NULL;
 
-	playerState_t *ps = SV_GameClientNum(num);
-	gentity_t *ent = SV_GentityNum(num);
+	pthread_mutex_lock(&downloadMutex);
 
-	if (bot_weapon[num])
-		ucmd.weapon = (byte)(bot_weapon[num] & 0xFF);
-	else
-		ucmd.weapon = (byte)(ps->weapon & 0xFF);
+	downloadPrefetches[clientNum].pending = false;
+	downloadPrefetches[clientNum].mapping = NULL;
 
-	if (ent->client == NULL)
-		return;
+	if (--mapping->refs == 0 && mapping->ioBusy == 0)
+		SV_UnmapDownload(mapping);
 
-	if (ent->client->sess.archiveTime == 0)
-	{
-		ucmd.buttons = bot_buttons[num];
+	pthread_mutex_unlock(&downloadMutex);
+}
 
-		ucmd.forwardmove = bot_forwardmove[num];
-		ucmd.rightmove = bot_rightmove[num];
+// The engine closes finished and dropped downloads itself, release their mappings once per frame
+void SV_ReleaseFinishedDownloads()
+{
+	int i;
 
-		VectorCopy(ent->client->sess.cmd.angles, ucmd.angles);
+	for (i = 0; i < MAX_CLIENTS; i++)
+	{
+		if (clientDownloadMappings[i] != NULL && (i >= sv_maxclients->integer || !svs.clients[i].download))
+			SV_ReleaseDownloadMapping(i);
 	}
+}
 
-	client->deltaMessage = client->netchan.outgoingSequence - 1;
+// Files are often overwritten in place, the mapping then reaches past the end of the file
+// and touching those pages raises SIGBUS
+static bool SV_DownloadMappingValid(downloadMapping_t *mapping)
+{
+	struct stat st;
+
+	return fstat(mapping->fd, &st) == 0 && st.st_size == mapping->size;
+}
+
+// Drops the mapping of a client and sends the rest with FS_Read like the engine does. Nothing
+// was read from the engine's handle yet, the blocks the client already has are skipped.
+static void SV_DownloadFromFile(client_t *cl)
+{
+	int curindex = 0;
+	int skip = cl->downloadClientBlock * MAX_DOWNLOAD_BLKSIZE;
+
+	Com_DPrintf("clientDownload: %d : \"%s\" changed on disk, reading it with FS_Read\n", cl - svs.clients, cl->downloadName);
+
+	SV_ReleaseDownloadMapping(cl - svs.clients);
+
+	cl->downloadCurrentBlock = cl->downloadXmitBlock = cl->downloadClientBlock;
+	cl->downloadCount = 0;
+	cl->downloadEOF = qfalse;
+
+	if (!cl->downloadBlocks[curindex])
+		cl->downloadBlocks[curindex] = (unsigned char *)Z_MallocInternal(MAX_DOWNLOAD_BLKSIZE);
+
+	while (cl->downloadCount < skip)
+	{
+		int length = skip - cl->downloadCount < MAX_DOWNLOAD_BLKSIZE ? skip - cl->downloadCount : MAX_DOWNLOAD_BLKSIZE;
+		int bytes = FS_Read( cl->downloadBlocks[curindex], length, cl->download );
+
+		if (bytes < length)
+		{
+			// the file got shorter than what was sent, end it like a short read would
+			cl->downloadCount = cl->downloadSize;
+			return;
+		}
+
+		cl->downloadCount += bytes;
+	}
+}
+
+void custom_SV_WriteDownloadToClient(client_t *cl, msg_t *msg)
+{
+	int curindex;
+	int iwdFile;
+	char errorMessage[MAX_STRINGLENGTH];
+
+	if (cl->state == CS_ACTIVE)
+		return; // Client already in game
+
+	if (!*cl->downloadName)
+		return;	// Nothing being downloaded
+
+	if (strlen(cl->downloadName) < 4)
+		return; // File length too short
+
+	if (strcmp(&cl->downloadName[strlen(cl->downloadName) - 4], ".iwd") != 0)
+		return; // Not a iwd file
+
+#if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	if ( cl->wwwDlAck )
+		return; // wwwDl acknowleged
+#endif
+
+	if (strlen(sv_downloadMessage->string))
+	{
+		Com_sprintf(errorMessage, sizeof(errorMessage), sv_downloadMessage->string);
+
+		MSG_WriteByte( msg, svc_download );
+		MSG_WriteShort( msg, 0 ); // client is expecting block zero
+		MSG_WriteLong( msg, -1 ); // illegal file size
+		MSG_WriteString( msg, errorMessage );
+
+		*cl->downloadName = 0;
+		return; // Download message instead of download
+	}
+
+#if COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	if (sv_wwwDownload->boolean && cl->wwwDownload)
+	{
+		if (!cl->wwwDl_failed)
+		{
+			SV_WWWRedirectClient(cl, msg);
+			return; // wwwDl redirect
+		}
+	}
+#endif
+
+	// Hardcode client variables to make max download speed for everyone
+	cl->state = CS_CONNECTED;
+	cl->rate = atoi(sv_downloadRate->string) > 0 ? atoi(sv_downloadRate->string) : 25000;
+	cl->snapshotMsec = 50;
+
+	if (!cl->download)
+	{
+		// We open the file here
+
+		Com_Printf("clientDownload: %d : begining \"%s\"\n", cl - svs.clients, cl->downloadName);
+
+		iwdFile = FS_iwIwd(cl->downloadName, "main");
+
+		if ( !sv_allowDownload->integer || iwdFile || ( cl->downloadSize = FS_SV_FOpenFileRead( cl->downloadName, &cl->download ) ) <= 0 )
+		{
+			// cannot auto-download file
+			if (iwdFile)
+			{
+				Com_Printf("clientDownload: %d : \"%s\" cannot download iwd files\n", cl - svs.clients, cl->downloadName);
+				Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_CANTAUTODLGAMEIWD\x15%s", cl->downloadName);
+			}
+			else if ( !sv_allowDownload->boolean )
+			{
+				Com_Printf("clientDownload: %d : \"%s\" download disabled\n", cl - svs.clients, cl->downloadName);
+
+				if (sv_pure->boolean)
+					Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_SERVERDISABLED_PURE\x15%s", cl->downloadName);
+				else
+					Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_SERVERDISABLED\x15%s", cl->downloadName);
+			}
+			else
+			{
+				Com_Printf("clientDownload: %d : \"%s\" file not found on server\n", cl - svs.clients, cl->downloadName);
+				Com_sprintf(errorMessage, sizeof(errorMessage), "EXE_AUTODL_FILENOTONSERVER\x15%s", cl->downloadName);
+			}
+
+			MSG_WriteByte( msg, svc_download );
+			MSG_WriteShort( msg, 0 ); // client is expecting block zero
+			MSG_WriteLong( msg, -1 ); // illegal file size
+			MSG_WriteString( msg, errorMessage );
+
+			*cl->downloadName = 0;
+			return;
+		}
+
+		// Init
+		cl->downloadCurrentBlock = cl->downloadClientBlock = cl->downloadXmitBlock = 0;
+		cl->downloadCount = 0;
+		cl->downloadEOF = qfalse;
+
+		// Blocks are sent from a mapping shared with other clients, the file handle only stays open for the engine to close
+		SV_ReleaseDownloadMapping(cl - svs.clients);
+		clientDownloadMappings[cl - svs.clients] = SV_AcquireDownloadMapping(cl->downloadName, cl->downloadSize);
+
+		memset(&downloadStates[cl - svs.clients], 0, sizeof(downloadState_t));
+		downloadStates[cl - svs.clients].window = 2;
+		downloadStates[cl - svs.clients].startTime = svs.time;
+	}
+
+	downloadMapping_t *mapping = clientDownloadMappings[cl - svs.clients];
+
+	if (mapping != NULL)
+		SV_PrefetchDownload(cl - svs.clients, mapping, cl->downloadClientBlock * MAX_DOWNLOAD_BLKSIZE, false);
+
+	// Perform any reads that we need to
+	while (cl->downloadCurrentBlock - cl->downloadClientBlock < MAX_DOWNLOAD_WINDOW && cl->downloadSize != cl->downloadCount)
+	{
+		curindex = (cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW);
+
+		if (mapping != NULL)
+		{
+			cl->downloadBlockSize[curindex] = cl->downloadSize - cl->downloadCount;
+
+			if (cl->downloadBlockSize[curindex] > MAX_DOWNLOAD_BLKSIZE)
+				cl->downloadBlockSize[curindex] = MAX_DOWNLOAD_BLKSIZE;
+
+			cl->downloadCount += cl->downloadBlockSize[curindex];
+			cl->downloadCurrentBlock++;
+			continue;
+		}
+
+		if (!cl->downloadBlocks[curindex])
+			cl->downloadBlocks[curindex] = (unsigned char *)Z_MallocInternal(MAX_DOWNLOAD_BLKSIZE);
+
+		cl->downloadBlockSize[curindex] = FS_Read( cl->downloadBlocks[curindex], MAX_DOWNLOAD_BLKSIZE, cl->download );
+
+		if (cl->downloadBlockSize[curindex] < 0)
+		{
+			// EOF right now
+			cl->downloadCount = cl->downloadSize;
+			break;
+		}
+
+		cl->downloadCount += cl->downloadBlockSize[curindex];
+
+		// Load in next block
+		cl->downloadCurrentBlock++;
+	}
+
+	// Check to see if we have eof condition and add the EOF block
+	if (cl->downloadCount == cl->downloadSize && !cl->downloadEOF && cl->downloadCurrentBlock - cl->downloadClientBlock < MAX_DOWNLOAD_WINDOW)
+	{
+		cl->downloadBlockSize[cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW] = 0;
+		cl->downloadCurrentBlock++;
+		cl->downloadEOF = qtrue;  // We have added the EOF block
+	}
+
+	// Write out the next section of the file, if we have already reached our window,
+	// automatically start retransmitting
+
+	if (cl->downloadClientBlock == cl->downloadCurrentBlock)
+		return; // Nothing to transmit
+
+	downloadState_t *state = &downloadStates[cl - svs.clients];
+
+	SV_DownloadAcknowledged(cl, state);
+
+	if (cl->downloadXmitBlock == cl->downloadCurrentBlock || cl->downloadXmitBlock - cl->downloadClientBlock >= state->window)
+	{
+		// We have transmitted the complete window, should we start resending?
+		// The timeout follows the measured round trip of this client's blocks
+		if (svs.time - cl->downloadSendTime > SV_DownloadTimeout(state))
+		{
+			// Lost blocks, multiplicative decrease
+			cl->downloadXmitBlock = cl->downloadClientBlock;
+			state->window = state->window / 2 > 0 ? state->window / 2 : 1;
+			state->acked = 0;
+			state->retransmits++;
+		}
+		else
+			return;
+	}
+
+	// Send as many blocks as the window allows, they go out with this snapshot.  The rate will keep us in line.
+	while (cl->downloadXmitBlock < cl->downloadCurrentBlock && cl->downloadXmitBlock - cl->downloadClientBlock < state->window)
+	{
+		if (msg->cursize + MAX_DOWNLOAD_BLKSIZE + 16 > msg->maxsize)
+			break;
+
+		curindex = (cl->downloadXmitBlock % MAX_DOWNLOAD_WINDOW);
+
+		if (!SV_DownloadBudgetAllows(state, cl->downloadBlockSize[curindex]))
+			break; // wait for the next round
+
+		if (mapping != NULL && cl->downloadBlockSize[curindex] && !SV_DownloadMappingValid(mapping))
+		{
+			SV_DownloadFromFile(cl);
+			return;
+		}
+
+		// Never fault on the disk here, a block that is not read yet waits for the read-ahead thread
+		if (mapping != NULL && cl->downloadBlockSize[curindex] && !SV_DownloadBlockResident(mapping, cl->downloadXmitBlock * MAX_DOWNLOAD_BLKSIZE, cl->downloadBlockSize[curindex]))
+		{
+			SV_PrefetchDownload(cl - svs.clients, mapping, cl->downloadXmitBlock * MAX_DOWNLOAD_BLKSIZE, true);
+			break;
+		}
+
+		MSG_WriteByte( msg, svc_download );
+		MSG_WriteShort( msg, cl->downloadXmitBlock );
+
+		// block zero is special, contains file size
+		if ( cl->downloadXmitBlock == 0 )
+			MSG_WriteLong( msg, cl->downloadSize );
+
+		MSG_WriteShort( msg, cl->downloadBlockSize[curindex] );
+
+		// Write the block
+		if ( cl->downloadBlockSize[curindex] )
+		{
+			if ( mapping != NULL )
+				MSG_WriteData( msg, mapping->data + cl->downloadXmitBlock * MAX_DOWNLOAD_BLKSIZE, cl->downloadBlockSize[curindex] );
+			else
+				MSG_WriteData( msg, cl->downloadBlocks[curindex], cl->downloadBlockSize[curindex] );
+		}
+
+		Com_DPrintf("clientDownload: %d : writing block %d\n", cl - svs.clients, cl->downloadXmitBlock);
+
+		state->blockSendTime[curindex] = svs.time;
+		state->blockResent[curindex] = cl->downloadXmitBlock < state->highestXmitBlock;
+		state->bytesSent += cl->downloadBlockSize[curindex];
+		downloadBytesTotal += cl->downloadBlockSize[curindex];
+		state->deficit -= cl->downloadBlockSize[curindex];
+
+		// Move on to the next block
+		cl->downloadXmitBlock++;
+
+		if (cl->downloadXmitBlock > state->highestXmitBlock)
+			state->highestXmitBlock = cl->downloadXmitBlock;
+
+		cl->downloadSendTime = svs.time;
+	}
+}
+
+// Segfault fix
+int hook_BG_IsWeaponValid(int a1, int a2)
+{
+	if ( !(unsigned char)sub_80E9758(a2) )
+		return 0;
+
+	if ( !(unsigned char)sub_80D9E84(a1 + 1348, a2) )
+		return 0;
+
+	int weapon = (int)BG_WeaponDefs(a2);
+
+	if ( !weapon )
+		return 0;
+
+	if ( !*(long *)(weapon + 132) && *(char *)(a1 + 1365) != a2 && *(char *)(a1 + 1366) != a2 && *(long *)(weapon + 876) != a2 )
+		return 0;
+
+	return 1;
+}
+
+char *custom_va(const char *format, ...)
+{
+	char *s;
+	va_list va;
+	int v1;
+	signed int v3;
+
+	v1 = Sys_GetValue(1);
+	s = (char *)(v1 + (*(int *)(v1 + 2048) << 10));
+	v3 = *(int *)(v1 + 2048) + 1;
+	*(int *)(v1 + 2048) = v3 / 2;
+	*(int *)(v1 + 2048) = v3 - 2 * *(int *)(v1 + 2048);
+
+	va_start(va, format);
+	vsnprintf(s, MAX_STRINGLENGTH, format, va);
+	va_end(va);
+
+	s[MAX_STRINGLENGTH - 1] = '\0';
+
+	return s;
+}
+
+void hook_SV_VerifyIwds_f(client_t *cl)
+{
+	if (sv_pure->boolean)
+		cl->pureAuthentic = 1;
+}
+
+void hook_SV_ResetPureClient_f(client_t *cl)
+{
+	cl->pureAuthentic = 0;
+
+	if (codecallback_vid_restart)
+	{
+		if (!Scr_IsSystemActive())
+			return;
+
+		if (cl->gentity == NULL)
+			return;
+
+		stackPushInt(cl - svs.clients);
+		short ret = Scr_ExecEntThread(cl->gentity, codecallback_vid_restart, 1);
+		Scr_FreeThread(ret);
+	}
+}
+
+#define NETSTATS_WINDOW 100 // snapshots kept for loss and min/max
+
+// Link quality per client, fed by snapshot acks as they show up instead of rescanning all frames
+typedef struct
+{
+	int active;
+	int nextMessage; // oldest snapshot still waiting for an ack
+	unsigned int resolved; // one bit per frame slot past nextMessage that was already counted
+	int samples;
+	float ping; // smoothed round trip
+	float jitter; // smoothed deviation from ping
+	short window[NETSTATS_WINDOW]; // round trips, -1 for a snapshot that was never acked
+	int windowHead;
+	int windowCount;
+} netStats_t;
+
+netStats_t netStats[MAX_CLIENTS];
+
+static void SV_NetStatsSample(netStats_t *stats, int delta)
+{
+	stats->window[stats->windowHead] = delta;
+	stats->windowHead = (stats->windowHead + 1) % NETSTATS_WINDOW;
+
+	if (stats->windowCount < NETSTATS_WINDOW)
+		stats->windowCount++;
+
+	if (delta < 0)
+		return;
+
+	// same gains as the TCP round trip estimator
+	if (!stats->samples)
+	{
+		stats->ping = delta;
+		stats->jitter = delta / 2.0f;
+	}
+	else
+	{
+		stats->jitter += (fabsf(delta - stats->ping) - stats->jitter) / 4;
+		stats->ping += (delta - stats->ping) / 8;
+	}
+
+	stats->samples++;
+}
+
+static void SV_NetStatsUpdate(client_t *cl, netStats_t *stats)
+{
+	int outgoing = cl->netchan.outgoingSequence;
+
+	if (!stats->active)
+	{
+		memset(stats, 0, sizeof(netStats_t));
+		stats->active = 1;
+		stats->nextMessage = outgoing;
+	}
+	else if (outgoing - stats->nextMessage > PACKET_BACKUP)
+	{
+		// slots were reused before we looked at them
+		stats->nextMessage = outgoing - PACKET_BACKUP;
+		stats->resolved = 0;
+	}
+
+	for (int message = stats->nextMessage; message < outgoing; message++)
+	{
+		unsigned int bit = 1u << (message & PACKET_MASK);
+
+		if (stats->resolved & bit)
+			continue;
+
+		clientSnapshot_t *frame = &cl->frames[message & PACKET_MASK];
+
+		if (frame->messageAcked != 0xFFFFFFFF)
+		{
+			int delta = frame->messageAcked - frame->messageSent;
+			SV_NetStatsSample(stats, delta > 999 ? 999 : delta);
+		}
+		else if (outgoing - message >= PACKET_BACKUP)
+		{
+			// the next snapshot takes this slot, assumes clients ack every snapshot they get
+			SV_NetStatsSample(stats, -1);
+		}
+		else
+			continue;
+
+		stats->resolved |= bit;
+	}
+
+	while (stats->nextMessage < outgoing && (stats->resolved & (1u << (stats->nextMessage & PACKET_MASK))))
+	{
+		stats->resolved &= ~(1u << (stats->nextMessage & PACKET_MASK));
+		stats->nextMessage++;
+	}
+}
+
+// Returns the number of snapshots in the window, loss is in percent
+int SV_ClientNetStats(int clientnum, int *ping, int *jitter, int *loss, int *minPing, int *maxPing)
+{
+	netStats_t *stats = &netStats[clientnum];
+	int lost = 0;
+
+	*ping = *jitter = *loss = *minPing = *maxPing = 0;
+
+	if (!stats->active || !stats->windowCount)
+		return 0;
+
+	*ping = (int)(stats->ping + 0.5f);
+	*jitter = (int)(stats->jitter + 0.5f);
+	*minPing = 999;
+
+	for (int i = 0; i < stats->windowCount; i++)
+	{
+		int delta = stats->window[i];
+
+		if (delta < 0)
+		{
+			lost++;
+			continue;
+		}
+
+		if (delta < *minPing)
+			*minPing = delta;
+
+		if (delta > *maxPing)
+			*maxPing = delta;
+	}
+
+	if (lost == stats->windowCount)
+		*minPing = 0;
+
+	*loss = lost * 100 / stats->windowCount;
+
+	return stats->windowCount;
+}
+
+// Adds bot pings and removes spam on 1.2 and 1.3
+void custom_SV_CalcPings( void )
+{
+	int i, j;
+	client_t *cl;
+	int total, count;
+	int delta;
+
+	PERF_BEGIN(perfStart);
+
+	for ( i = 0 ; i < sv_maxclients->integer ; i++ )
+	{
+		cl = &svs.clients[i];
+
+		if ( cl->state != CS_ACTIVE )
+		{
+			cl->ping = -1;
+			netStats[i].active = 0;
+			continue;
+		}
+
+		if ( !cl->gentity )
+		{
+			cl->ping = -1;
+			netStats[i].active = 0;
+			continue;
+		}
+
+		if ( cl->netchan.remoteAddress.type == NA_BOT )
+		{
+			cl->ping = 0;
+			cl->lastPacketTime = svs.time;
+			netStats[i].active = 0;
+			continue;
+		}
+
+		SV_NetStatsUpdate(cl, &netStats[i]);
+
+		total = 0;
+		count = 0;
+
+		for ( j = 0 ; j < PACKET_BACKUP ; j++ )
+		{
+			if ( cl->frames[j].messageAcked == 0xFFFFFFFF )
+				continue;
+
+			delta = cl->frames[j].messageAcked - cl->frames[j].messageSent;
+			count++;
+			total += delta;
+		}
+
+		if ( !count )
+			cl->ping = 999;
+		else
+		{
+			cl->ping = total / count;
+
+			if ( cl->ping > 999 )
+				cl->ping = 999;
+		}
+	}
+
+	PERF_END(PERF_PINGS, perfStart);
+}
+
+void custom_SV_CheckTimeouts( void )
+{
+	int	i;
+	client_t *cl;
+	int	droppoint;
+	int	zombiepoint;
+
+#if COMPILE_WATCHDOG == 1
+	watchdog_heartbeat(atoi(sv_watchdog->string));
+#endif
+
+#if COMPILE_PERFSTATS == 1
+	perf_frame();
+#endif
+
+	droppoint = svs.time - 1000 * sv_timeout->integer;
+	zombiepoint = svs.time - 1000 * sv_zombietime->integer;
+
+	for ( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ )
+	{
+		// message times may be wrong across a changelevel
+		if (cl->lastPacketTime > svs.time)
+			cl->lastPacketTime = svs.time;
+
+		if (cl->state == CS_ZOMBIE && cl->lastPacketTime < zombiepoint)
+		{
+			cl->state = CS_FREE; // can now be reused
+			continue;
+		}
+
+		if (cl->state >= CS_CONNECTED && cl->lastPacketTime < droppoint)
+		{
+			// wait several frames so a debugger session doesn't
+			// cause a timeout
+			if ( ++cl->timeoutCount > 5 )
+			{
+				SV_DropClient(cl, "EXE_TIMEDOUT");
+				cl->state = CS_FREE; // don't bother with zombie state
+			}
+		}
+		else
+			cl->timeoutCount = 0;
+	}
+
+	// deliver finished async tasks to callbacks and await handles
+	PERF_BEGIN(perfStart);
+
+#if COMPILE_EXEC == 1
+	WATCHDOG_MARK("exec_async_deliver");
+	exec_async_deliver();
+#endif
+
+#if COMPILE_MYSQL_DEFAULT == 1 && (COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3)
+	WATCHDOG_MARK("mysql_async_deliver");
+	mysql_async_deliver();
+#endif
+
+#if COMPILE_MYSQL_VORON == 1
+	WATCHDOG_MARK("mysql_async_deliver");
+	mysql_async_deliver();
+#endif
+
+#if COMPILE_SQLITE == 1
+	WATCHDOG_MARK("sqlite_async_deliver");
+	sqlite_async_deliver();
+#endif
+
+#if COMPILE_RESOLVER == 1
+	WATCHDOG_MARK("net_resolver_deliver");
+	net_resolver_deliver();
+#endif
+
+	PERF_END(PERF_ASYNC, perfStart);
+
+	WATCHDOG_MARK("SV_UpdateServices");
+	SV_UpdateServices();
+
+	WATCHDOG_MARK("SV_ScheduleDownloads");
+	SV_ReleaseFinishedDownloads();
+	SV_ScheduleDownloads();
+
+	manymaps_preload_report();
+
+#if COMPILE_METRICS == 1
+	WATCHDOG_MARK("SV_PublishMetrics");
+	SV_PublishMetrics();
+#endif
+
+#if COMPILE_SHMSTATS == 1
+	WATCHDOG_MARK("SV_UpdateShmStats");
+	SV_UpdateShmStats();
+#endif
+
+	WATCHDOG_MARK(NULL);
+}
+
+#if COMPILE_BOTS == 1
+int bot_buttons[MAX_CLIENTS] = {0};
+int bot_weapon[MAX_CLIENTS] = {0};
+char bot_forwardmove[MAX_CLIENTS] = {0};
+char bot_rightmove[MAX_CLIENTS] = {0};
+void custom_SV_BotUserMove(client_t *client)
+{
+	int num;
+	usercmd_t ucmd = {0};
+
+	if (client->gentity == NULL)
+		return;
+
+	num = client - svs.clients;
+	ucmd.serverTime = svs.time;
+
+	playerState_t *ps = SV_GameClientNum(num);
+	gentity_t *ent = SV_GentityNum(num);
+
+	if (bot_weapon[num])
+		ucmd.weapon = (byte)(bot_weapon[num] & 0xFF);
+	else
+		ucmd.weapon = (byte)(ps->weapon & 0xFF);
+
+	if (ent->client == NULL)
+		return;
+
+	if (ent->client->sess.archiveTime == 0)
+	{
+		ucmd.buttons = bot_buttons[num];
+
+		ucmd.forwardmove = bot_forwardmove[num];
+		ucmd.rightmove = bot_rightmove[num];
+
+		VectorCopy(ent->client->sess.cmd.angles, ucmd.angles);
+	}
+
+	client->deltaMessage = client->netchan.outgoingSequence - 1;
 	SV_ClientThink(client, &ucmd);
 }
-#endif
+#endif
+
+void hook_scriptError(int a1, int a2, int a3, void *a4)
+{
+	if (developer->integer == 2)
+		runtimeError(0, a1, a2, a3);
+	else
+		scriptError(a1, a2, a3, a4);
+}
+
+#if COMPILE_PLAYER == 1
+int gamestate_size[MAX_CLIENTS] = {0};
+void hook_gamestate_info(const char *format, ...)
+{
+	char s[MAX_STRINGLENGTH];
+	va_list va;
+
+	va_start(va, format);
+	vsnprintf(s, sizeof(s), format, va);
+	va_end(va);
+
+	Com_DPrintf("%s", s);
+
+	char *tok;
+	int gamestate = 0;
+	int clientnum = 0;
+	tok = strtok(s, " ");
+
+	for (int i = 0; tok != NULL; i++)
+	{
+		if (i == 1)
+			gamestate = atoi(tok);
+		if (i == 7)
+			clientnum = atoi(tok);
+		tok = strtok(NULL, " ");
+	}
+
+	gamestate_size[clientnum] = gamestate;
+}
+
+int clientfps[MAX_CLIENTS] = {0};
+int tempfps[MAX_CLIENTS] = {0};
+int fpstime[MAX_CLIENTS] = {0};
+
+int previousbuttons[MAX_CLIENTS] = {0};
+
+cHook *hook_play_movement;
+int play_movement(client_t *cl, usercmd_t *ucmd)
+{
+	int (*sig)(client_t *cl, usercmd_t *ucmd);
+	*(int *)&sig = hook_play_movement->trampoline;
+
+	PERF_BEGIN(perfStart);
+
+	int ret = sig(cl, ucmd);
+
+	int clientnum = cl - svs.clients;
+
+	tempfps[clientnum]++;
+
+	if (Sys_MilliSeconds() >= (fpstime[clientnum] + 1000))
+	{
+		clientfps[clientnum] = tempfps[clientnum];
+		fpstime[clientnum] = Sys_MilliSeconds();
+		tempfps[clientnum] = 0;
+	}
+
+	if(ucmd->buttons & KEY_MASK_MELEE && !(previousbuttons[clientnum] & KEY_MASK_MELEE))
+	{
+		if(codecallback_meleebutton)
+		{
+			PERF_BEGIN(scriptStart);
+			short ret = Scr_ExecEntThread(cl->gentity, codecallback_meleebutton, 0);
+			Scr_FreeThread(ret);
+			PERF_END(PERF_SCRIPT, scriptStart);
+		}
+	}
+
+	if(ucmd->buttons & KEY_MASK_USE && !(previousbuttons[clientnum] & KEY_MASK_USE))
+	{
+		if(codecallback_usebutton)
+		{
+			PERF_BEGIN(scriptStart);
+			short ret = Scr_ExecEntThread(cl->gentity, codecallback_usebutton, 0);
+			Scr_FreeThread(ret);
+			PERF_END(PERF_SCRIPT, scriptStart);
+		}
+	}
+
+	if(ucmd->buttons & KEY_MASK_FIRE && !(previousbuttons[clientnum] & KEY_MASK_FIRE))
+	{
+		if(codecallback_attackbutton)
+		{
+			PERF_BEGIN(scriptStart);
+			short ret = Scr_ExecEntThread(cl->gentity, codecallback_attackbutton, 0);
+			Scr_FreeThread(ret);
+			PERF_END(PERF_SCRIPT, scriptStart);
+		}
+	}
+
+	previousbuttons[clientnum] = ucmd->buttons;
+
+	PERF_END(PERF_USERCMD, perfStart);
+
+	return ret;
+}
+
+int player_g_speed[MAX_CLIENTS] = {0};
+int player_g_gravity[MAX_CLIENTS] = {0};
+cHook *hook_play_endframe;
+int play_endframe(gentity_t *ent)
+{
+	int (*sig)(gentity_t *ent);
+	*(int *)&sig = hook_play_endframe->trampoline;
+
+	int ret = sig(ent);
+
+	if (ent->client->sess.state == STATE_PLAYING)
+	{
+		int num = ent - g_entities;
+
+		if (player_g_speed[num] > 0)
+			ent->client->ps.speed = player_g_speed[num];
+
+		if (player_g_gravity[num] > 0)
+			ent->client->ps.gravity = player_g_gravity[num];
+	}
+
+	return ret;
+}
+
+int custom_animation[MAX_CLIENTS] = {0};
+cHook *hook_set_anim;
+int set_anim(playerState_t *ps, int animNum, animBodyPart_t bodyPart, int forceDuration, qboolean setTimer, qboolean isContinue, qboolean force)
+{
+	int (*sig)(playerState_t *ps, int animNum, animBodyPart_t bodyPart, int forceDuration, qboolean setTimer, qboolean isContinue, qboolean force);
+	*(int *)&sig = hook_set_anim->trampoline;
+
+	int ret;
+
+	if (!custom_animation[ps->clientNum])
+		ret = sig(ps, animNum, bodyPart, forceDuration, setTimer, isContinue, force);
+	else
+		ret = sig(ps, custom_animation[ps->clientNum], bodyPart, forceDuration, qtrue, isContinue, qtrue);
+
+	return ret;
+}
+#endif
+
+#if COMPILE_RATELIMITER == 1
+// ioquake3 rate limit connectionless requests
+// https://github.com/ioquake/ioq3/blob/master/code/server/sv_main.c
+
+// This is deliberately quite large to make it more of an effort to DoS
+#define MAX_BUCKETS	16384
+#define MAX_HASHES 1024
+
+static leakyBucket_t buckets[ MAX_BUCKETS ];
+static leakyBucket_t* bucketHashes[ MAX_HASHES ];
+static leakyBucket_t* bucketLruHead = NULL; // most recently used
+static leakyBucket_t* bucketLruTail = NULL; // first candidate for reclaiming
+static leakyBucket_t* bucketFree = NULL;
+static bool bucketsInitialized = false;
+
+static long SVC_HashForAddress( netadr_t address, int prefix )
+{
+	unsigned char *ip = address.ip;
+	int	i;
+	long hash = prefix;
+
+	for ( i = 0; i < 4; i++ )
+	{
+		hash += (long)( ip[ i ] ) * ( i + 119 );
+	}
+
+	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
+	hash &= ( MAX_HASHES - 1 );
+
+	return hash;
+}
+
+static void SVC_InitBuckets( void )
+{
+	int i;
+
+	memset( buckets, 0, sizeof( buckets ) );
+	memset( bucketHashes, 0, sizeof( bucketHashes ) );
+
+	bucketLruHead = NULL;
+	bucketLruTail = NULL;
+	bucketFree = NULL;
+
+	for ( i = MAX_BUCKETS - 1; i >= 0; i-- )
+	{
+		buckets[ i ].lruNext = bucketFree;
+		bucketFree = &buckets[ i ];
+	}
+
+	bucketsInitialized = true;
+}
+
+static void SVC_UnlinkBucketLru( leakyBucket_t *bucket )
+{
+	if ( bucket->lruPrev != NULL )
+		bucket->lruPrev->lruNext = bucket->lruNext;
+	else
+		bucketLruHead = bucket->lruNext;
+
+	if ( bucket->lruNext != NULL )
+		bucket->lruNext->lruPrev = bucket->lruPrev;
+	else
+		bucketLruTail = bucket->lruPrev;
+}
+
+static void SVC_LinkBucketLru( leakyBucket_t *bucket )
+{
+	bucket->lruPrev = NULL;
+	bucket->lruNext = bucketLruHead;
+
+	if ( bucketLruHead != NULL )
+		bucketLruHead->lruPrev = bucket;
+	else
+		bucketLruTail = bucket;
+
+	bucketLruHead = bucket;
+}
+
+static leakyBucket_t *SVC_BucketForAddress( netadr_t address, int prefix, int burst, int period )
+{
+	leakyBucket_t *bucket = NULL;
+	int	i;
+
+	// Keep the network part only, a /24 bucket is shared by all of its addresses
+	for ( i = 0; i < 4; i++ )
+	{
+		int bits = prefix - i * 8;
+
+		if ( bits <= 0 )
+			address.ip[ i ] = 0;
+		else if ( bits < 8 )
+			address.ip[ i ] &= 0xFF << ( 8 - bits );
+	}
+
+	long hash = SVC_HashForAddress( address, prefix );
+	int	now = Sys_MilliSeconds();
+
+	if ( !bucketsInitialized )
+		SVC_InitBuckets();
+
+	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next )
+	{
+		if ( bucket->prefix == prefix && memcmp( bucket->adr, address.ip, 4 ) == 0 )
+		{
+			if ( bucket != bucketLruHead )
+			{
+				SVC_UnlinkBucketLru( bucket );
+				SVC_LinkBucketLru( bucket );
+			}
+
+			return bucket;
+		}
+	}
+
+	if ( bucketFree != NULL )
+	{
+		bucket = bucketFree;
+		bucketFree = bucket->lruNext;
+	}
+	else
+	{
+		// Reclaim the least recently used bucket, if nothing has expired every bucket is in use
+		int interval;
+
+		bucket = bucketLruTail;
+		interval = now - bucket->lastTime;
+
+		if ( interval <= ( burst * period ) && interval >= 0 )
+		{
+			// Couldn't allocate a bucket for this address
+			return NULL;
+		}
+
+		if ( bucket->prev != NULL )
+		{
+			bucket->prev->next = bucket->next;
+		}
+		else
+		{
+			bucketHashes[ bucket->hash ] = bucket->next;
+		}
+
+		if ( bucket->next != NULL )
+		{
+			bucket->next->prev = bucket->prev;
+		}
+
+		SVC_UnlinkBucketLru( bucket );
+	}
+
+	memset( bucket, 0, sizeof( leakyBucket_t ) );
+
+	bucket->type = address.type;
+	bucket->prefix = prefix;
+	memcpy( bucket->adr, address.ip, 4 );
+
+	bucket->lastTime = now;
+	bucket->burst = 0;
+	bucket->hash = hash;
+
+	// Add to the head of the relevant hash chain
+	bucket->next = bucketHashes[ hash ];
+	if ( bucketHashes[ hash ] != NULL )
+	{
+		bucketHashes[ hash ]->prev = bucket;
+	}
+
+	bucket->prev = NULL;
+	bucketHashes[ hash ] = bucket;
+
+	SVC_LinkBucketLru( bucket );
+
+	return bucket;
+}
+
+bool SVC_RateLimit( leakyBucket_t *bucket, int burst, int period )
+{
+	if ( bucket != NULL )
+	{
+		int now = Sys_MilliSeconds();
+		int interval = now - bucket->lastTime;
+		int expired = interval / period;
+		int expiredRemainder = interval % period;
+
+		if ( expired > bucket->burst || interval < 0 )
+		{
+			bucket->burst = 0;
+			bucket->lastTime = now;
+		}
+		else
+		{
+			bucket->burst -= expired;
+			bucket->lastTime = now - expiredRemainder;
+		}
+
+		if ( bucket->burst < burst )
+		{
+			bucket->burst++;
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool SVC_RateLimitAddress( netadr_t from, int burst, int period )
+{
+	leakyBucket_t *bucket = SVC_BucketForAddress( from, 32, burst, period );
+
+	return SVC_RateLimit( bucket, burst, period );
+}
+
+enum
+{
+	RATELIMIT_RCON,
+	RATELIMIT_CHALLENGE,
+	RATELIMIT_INFO,
+	RATELIMIT_STATUS,
+	RATELIMIT_COUNT
+};
+
+typedef struct
+{
+	const char *name;
+	const char *burstName;
+	const char *periodName;
+	const char *globalBurstName;
+	const char *globalPeriodName;
+	const char *burstDefault;
+	const char *periodDefault;
+	const char *globalBurstDefault;
+	const char *globalPeriodDefault;
+	cvar_t *burst;
+	cvar_t *period;
+	cvar_t *globalBurst;
+	cvar_t *globalPeriod;
+	leakyBucket_t globalBucket;
+	unsigned int served;
+	unsigned int droppedAddress;
+	unsigned int droppedSubnet;
+	unsigned int droppedGlobal;
+} rateLimitPolicy_t;
+
+static rateLimitPolicy_t rateLimitPolicies[ RATELIMIT_COUNT ] =
+{
+	{ "SVC_RemoteCommand", "sv_rconRateBurst", "sv_rconRatePeriod", "sv_rconGlobalBurst", "sv_rconGlobalPeriod", "10", "1000", "10", "1000" },
+	{ "SV_GetChallenge", "sv_challengeRateBurst", "sv_challengeRatePeriod", "sv_challengeGlobalBurst", "sv_challengeGlobalPeriod", "10", "1000", "10", "100" },
+	{ "SVC_Info", "sv_infoRateBurst", "sv_infoRatePeriod", "sv_infoGlobalBurst", "sv_infoGlobalPeriod", "10", "1000", "10", "100" },
+	{ "SVC_Status", "sv_statusRateBurst", "sv_statusRatePeriod", "sv_statusGlobalBurst", "sv_statusGlobalPeriod", "10", "1000", "10", "100" },
+};
+
+cvar_t *sv_rateLimitSubnetScale;
+
+void SVC_RegisterRateLimitCvars( void )
+{
+	int i;
+
+	for ( i = 0; i < RATELIMIT_COUNT; i++ )
+	{
+		rateLimitPolicy_t *policy = &rateLimitPolicies[ i ];
+
+		policy->burst = Cvar_RegisterString( policy->burstName, policy->burstDefault, CVAR_ARCHIVE );
+		policy->period = Cvar_RegisterString( policy->periodName, policy->periodDefault, CVAR_ARCHIVE );
+		policy->globalBurst = Cvar_RegisterString( policy->globalBurstName, policy->globalBurstDefault, CVAR_ARCHIVE );
+		policy->globalPeriod = Cvar_RegisterString( policy->globalPeriodName, policy->globalPeriodDefault, CVAR_ARCHIVE );
+	}
+
+	// burst of a /24 relative to a single address, 0 disables the subnet buckets
+	sv_rateLimitSubnetScale = Cvar_RegisterString( "sv_rateLimitSubnetScale", "4", CVAR_ARCHIVE );
+}
+
+static int SVC_RateLimitValue( cvar_t *cvar, int min )
+{
+	int value = atoi( cvar->string );
+
+	return value < min ? min : value;
+}
+
+// Checks the /32, /24 and, when global is set, the per command bucket
+bool SVC_RateLimitCommand( int command, netadr_t from, bool global )
+{
+	rateLimitPolicy_t *policy = &rateLimitPolicies[ command ];
+	int burst = SVC_RateLimitValue( policy->burst, 0 );
+	int period = SVC_RateLimitValue( policy->period, 1 );
+	int subnetBurst = burst * SVC_RateLimitValue( sv_rateLimitSubnetScale, 0 );
+
+	if ( SVC_RateLimit( SVC_BucketForAddress( from, 32, burst, period ), burst, period ) )
+	{
+		policy->droppedAddress++;
+		Com_DPrintf( "%s: rate limit from %s exceeded, dropping request\n", policy->name, NET_AdrToString( from ) );
+		return true;
+	}
+
+	// Floods rotating through a /24 share one bucket
+	if ( subnetBurst > 0 && SVC_RateLimit( SVC_BucketForAddress( from, 24, subnetBurst, period ), subnetBurst, period ) )
+	{
+		policy->droppedSubnet++;
+		Com_DPrintf( "%s: rate limit from %s/24 exceeded, dropping request\n", policy->name, NET_AdrToString( from ) );
+		return true;
+	}
+
+	if ( global )
+	{
+		int globalBurst = SVC_RateLimitValue( policy->globalBurst, 0 );
+		int globalPeriod = SVC_RateLimitValue( policy->globalPeriod, 1 );
+
+		if ( SVC_RateLimit( &policy->globalBucket, globalBurst, globalPeriod ) )
+		{
+			policy->droppedGlobal++;
+			Com_DPrintf( "%s: rate limit exceeded, dropping request\n", policy->name );
+			return true;
+		}
+	}
+
+	policy->served++;
+
+	return false;
+}
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+void SVC_RateLimitStats( void )
+{
+	int i;
+
+	if ( Cmd_Argc() > 1 && strcmp( Cmd_Argv( 1 ), "reset" ) == 0 )
+	{
+		for ( i = 0; i < RATELIMIT_COUNT; i++ )
+		{
+			rateLimitPolicies[ i ].served = 0;
+			rateLimitPolicies[ i ].droppedAddress = 0;
+			rateLimitPolicies[ i ].droppedSubnet = 0;
+			rateLimitPolicies[ i ].droppedGlobal = 0;
+		}
+
+		Com_Printf( "Rate limit counters reset\n" );
+		return;
+	}
+
+	Com_Printf( "%-20s %10s %10s %10s %10s\n", "command", "served", "address", "subnet", "global" );
+
+	for ( i = 0; i < RATELIMIT_COUNT; i++ )
+	{
+		rateLimitPolicy_t *policy = &rateLimitPolicies[ i ];
+
+		Com_Printf( "%-20s %10u %10u %10u %10u\n", policy->name, policy->served, policy->droppedAddress, policy->droppedSubnet, policy->droppedGlobal );
+	}
+}
+#endif
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+// Floods synthetic addresses through the limiter, the live buckets are restored afterwards
+void SVC_RateLimitBenchmark( void )
+{
+	int packets = 1000000;
+	int limited = 0;
+	int i;
+
+	if ( Cmd_Argc() > 1 )
+		packets = atoi( Cmd_Argv( 1 ) );
+
+	if ( packets <= 0 )
+	{
+		Com_Printf( "Usage: ratelimitbench [packets]\n" );
+		return;
+	}
+
+	if ( !bucketsInitialized )
+		SVC_InitBuckets();
+
+	leakyBucket_t *savedBuckets = (leakyBucket_t *)malloc( sizeof( buckets ) );
+
+	if ( savedBuckets == NULL )
+		return;
+
+	leakyBucket_t *savedHashes[ MAX_HASHES ];
+	leakyBucket_t *savedLruHead = bucketLruHead;
+	leakyBucket_t *savedLruTail = bucketLruTail;
+	leakyBucket_t *savedFree = bucketFree;
+
+	memcpy( savedBuckets, buckets, sizeof( buckets ) );
+	memcpy( savedHashes, bucketHashes, sizeof( bucketHashes ) );
+
+	netadr_t from;
+	unsigned int seed = 0x2545F491;
+	struct timespec start, end;
+
+	memset( &from, 0, sizeof( from ) );
+	from.type = NA_IP;
+
+	clock_gettime( CLOCK_MONOTONIC, &start );
+
+	for ( i = 0; i < packets; i++ )
+	{
+		// spoofed sources, nearly every packet misses the hash chains
+		seed = seed * 1664525 + 1013904223;
+		memcpy( from.ip, &seed, 4 );
+
+		if ( SVC_RateLimitAddress( from, 10, 1000 ) )
+			limited++;
+	}
+
+	clock_gettime( CLOCK_MONOTONIC, &end );
+
+	memcpy( buckets, savedBuckets, sizeof( buckets ) );
+	memcpy( bucketHashes, savedHashes, sizeof( bucketHashes ) );
+	bucketLruHead = savedLruHead;
+	bucketLruTail = savedLruTail;
+	bucketFree = savedFree;
+
+	free( savedBuckets );
+
+	double seconds = ( end.tv_sec - start.tv_sec ) + ( end.tv_nsec - start.tv_nsec ) / 1e9;
+
+	Com_Printf( "ratelimitbench: %d packets in %.3f ms, %.0f packets/s, %d limited\n", packets, seconds * 1000, seconds > 0 ? packets / seconds : 0, limited );
+}
+#endif
+
+void hook_SVC_RemoteCommand(netadr_t from, msg_t *msg)
+{
+	if (!sv_allowRcon->boolean)
+		return;
+
+	bool badRconPassword = !strlen( rcon_password->string ) || strcmp(Cmd_Argv(1), rcon_password->string) != 0;
+
+	// Prevent using rcon as an amplifier and make dictionary attacks impractical,
+	// bad passwords also share a global bucket to make DoS via rcon impractical
+	if ( SVC_RateLimitCommand( RATELIMIT_RCON, from, badRconPassword ) )
+		return;
+
+	if (!codecallback_remotecommand || badRconPassword || !Scr_IsSystemActive() || strcmp(Cmd_Argv(2), "map") == 0 || strcmp(Cmd_Argv(2), "devmap") == 0)
+	{
+		RemoteCommand(from, msg);
+	}
+	else
+	{
+		stackPushInt((int)msg);
+
+		stackPushArray();
+		int args = Cmd_Argc();
+		for (int i = 2; i < args; i++)
+		{
+			char tmp[MAX_STRINGLENGTH];
+			SV_Cmd_ArgvBuffer(i, tmp, sizeof(tmp));
+			stackPushString(tmp);
+			stackPushArrayLast();
+		}
+
+		stackPushString(NET_AdrToString(from));
+	
+		short ret = Scr_ExecThread(codecallback_remotecommand, 3);
+		Scr_FreeThread(ret);
+	}
+}
 
-void hook_scriptError(int a1, int a2, int a3, void *a4)
+void hook_SV_GetChallenge(netadr_t from)
 {
-	if (developer->integer == 2)
-		runtimeError(0, a1, a2, a3);
-	else
-		scriptError(a1, a2, a3, a4);
+	// Prevent using getchallenge as an amplifier, the global bucket prevents
+	// excess outbound bandwidth usage when being flooded inbound
+	if ( SVC_RateLimitCommand( RATELIMIT_CHALLENGE, from, true ) )
+		return;
+
+	SV_GetChallenge(from);
 }
 
-#if COMPILE_PLAYER == 1
-int gamestate_size[MAX_CLIENTS] = {0};
-void hook_gamestate_info(const char *format, ...)
+void hook_SVC_Info(netadr_t from)
 {
-	char s[MAX_STRINGLENGTH];
-	va_list va;
+	// Prevent using getinfo as an amplifier, the global bucket prevents
+	// excess outbound bandwidth usage when being flooded inbound
+	if ( SVC_RateLimitCommand( RATELIMIT_INFO, from, true ) )
+		return;
 
-	va_start(va, format);
-	vsnprintf(s, sizeof(s), format, va);
-	va_end(va);
+	SVC_Info(from);
+}
 
-	Com_DPrintf("%s", s);
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+#define MAX_STATUS_LENGTH 0x4000
 
-	char *tok;
-	int gamestate = 0;
-	int clientnum = 0;
-	tok = strtok(s, " ");
+typedef struct
+{
+	bool valid;
+	int time;
+	char serverinfo[MAX_INFO_STRING];
+	bool connected[MAX_CLIENTS];
+	char players[MAX_STATUS_LENGTH];
+} statusCache_t;
 
-	for (int i = 0; tok != NULL; i++)
+static statusCache_t statusCache;
+
+void SVC_InvalidateStatusCache( void )
+{
+	statusCache.valid = false;
+}
+
+static bool SVC_StatusCacheIsValid( const char *serverinfo )
+{
+	int i;
+
+	if ( !statusCache.valid )
+		return false;
+
+	int interval = Sys_MilliSeconds() - statusCache.time;
+
+	if ( interval >= atoi( sv_statusCacheTime->string ) || interval < 0 )
+		return false;
+
+	// Serverinfo changes, same content keeps the cache
+	if ( strcmp( serverinfo, statusCache.serverinfo ) != 0 )
+		return false;
+
+	// Client connects and disconnects
+	for ( i = 0; i < sv_maxclients->integer && i < MAX_CLIENTS; i++ )
 	{
-		if (i == 1)
-			gamestate = atoi(tok);
-		if (i == 7)
-			clientnum = atoi(tok);
-		tok = strtok(NULL, " ");
+		if ( ( svs.clients[i].state >= CS_CONNECTED ) != statusCache.connected[i] )
+			return false;
 	}
 
-	gamestate_size[clientnum] = gamestate;
+	return true;
 }
 
-int clientfps[MAX_CLIENTS] = {0};
-int tempfps[MAX_CLIENTS] = {0};
-int fpstime[MAX_CLIENTS] = {0};
+static void SVC_BuildStatusCache( const char *serverinfo )
+{
+	char player[MAX_STRINGLENGTH];
+	int length = 0;
+	int i;
 
-int previousbuttons[MAX_CLIENTS] = {0};
+	strncpy( statusCache.serverinfo, serverinfo, sizeof( statusCache.serverinfo ) - 1 );
+	statusCache.serverinfo[ sizeof( statusCache.serverinfo ) - 1 ] = '\0';
 
-cHook *hook_play_movement;
-int play_movement(client_t *cl, usercmd_t *ucmd)
-{
-	hook_play_movement->unhook();
+	memset( statusCache.connected, 0, sizeof( statusCache.connected ) );
+	statusCache.players[0] = '\0';
 
-	int (*sig)(client_t *cl, usercmd_t *ucmd);
-	*(int *)&sig = hook_play_movement->from;
+	for ( i = 0; i < sv_maxclients->integer && i < MAX_CLIENTS; i++ )
+	{
+		client_t *cl = &svs.clients[i];
 
-	int ret = sig(cl, ucmd);
+		if ( cl->state < CS_CONNECTED )
+			continue;
 
-	hook_play_movement->hook();
+		statusCache.connected[i] = true;
 
-	int clientnum = cl - svs.clients;
+		// playerState_t is the first member of gclient_t
+		gclient_t *gclient = (gclient_t *)SV_GameClientNum( i );
+		int playerLength = snprintf( player, sizeof( player ), "%i %i \"%s\"\n", gclient->sess.score, cl->ping, cl->name );
 
-	tempfps[clientnum]++;
+		if ( playerLength < 0 || length + playerLength >= (int)sizeof( statusCache.players ) )
+			break;
 
-	if (Sys_MilliSeconds() >= (fpstime[clientnum] + 1000))
-	{
-		clientfps[clientnum] = tempfps[clientnum];
-		fpstime[clientnum] = Sys_MilliSeconds();
-		tempfps[clientnum] = 0;
+		memcpy( statusCache.players + length, player, playerLength + 1 );
+		length += playerLength;
 	}
 
-	if(ucmd->buttons & KEY_MASK_MELEE && !(previousbuttons[clientnum] & KEY_MASK_MELEE))
+	statusCache.time = Sys_MilliSeconds();
+	statusCache.valid = true;
+}
+#endif
+
+void hook_SVC_Status(netadr_t from)
+{
+	// Prevent using getstatus as an amplifier, the global bucket prevents
+	// excess outbound bandwidth usage when being flooded inbound
+	if ( SVC_RateLimitCommand( RATELIMIT_STATUS, from, true ) )
+		return;
+
+#if COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3
+	if ( atoi( sv_statusCacheTime->string ) > 0 )
 	{
-		if(codecallback_meleebutton)
-		{
-			short ret = Scr_ExecEntThread(cl->gentity, codecallback_meleebutton, 0);
-			Scr_FreeThread(ret);
-		}
+		char infostring[MAX_INFO_STRING];
+		const char *serverinfo = SV_GetConfigstringConst( 0 ); // CS_SERVERINFO
+
+		if ( !SVC_StatusCacheIsValid( serverinfo ) )
+			SVC_BuildStatusCache( serverinfo );
+
+		// The challenge differs per query and is not part of the cache
+		memcpy( infostring, statusCache.serverinfo, sizeof( infostring ) );
+		Info_SetValueForKey( infostring, "challenge", Cmd_Argv( 1 ) );
+
+		NET_OutOfBandPrint( NS_SERVER, from, "statusResponse\n%s\n%s", infostring, statusCache.players );
+		return;
 	}
+#endif
 
-	if(ucmd->buttons & KEY_MASK_USE && !(previousbuttons[clientnum] & KEY_MASK_USE))
+	SVC_Status(from);
+}
+#endif
+
+#if COMPILE_METRICS == 1
+// Copies the numbers the metrics thread serves, it never reads game state itself
+void SV_PublishMetrics()
+{
+	static int lastPublish = 0;
+	int now = Sys_MilliSeconds();
+
+	if (!metrics_running() || (lastPublish && now - lastPublish < METRICS_INTERVAL))
+		return;
+
+	lastPublish = now;
+
+	metricsSnapshot_t *snapshot = metrics_snapshot_begin();
+
+	snapshot->maxclients = sv_maxclients->integer < MAX_CLIENTS ? sv_maxclients->integer : MAX_CLIENTS;
+
+	for (int i = 0; i < snapshot->maxclients; i++)
 	{
-		if(codecallback_usebutton)
+		client_t *cl = &svs.clients[i];
+		metricsClient_t *client = &snapshot->clients[i];
+
+		client->state = cl->state;
+		client->bot = cl->netchan.remoteAddress.type == NA_BOT;
+		client->ping = cl->ping;
+		client->rate = cl->rate;
+		strncpy(client->name, cl->name, sizeof(client->name) - 1);
+
+		if (cl->download)
 		{
-			short ret = Scr_ExecEntThread(cl->gentity, codecallback_usebutton, 0);
-			Scr_FreeThread(ret);
+			downloadState_t *state = &downloadStates[i];
+			int elapsed = svs.time - state->startTime;
+
+			client->downloading = 1;
+			client->downloadBytes = state->bytesSent;
+			client->downloadRate = elapsed > 0 ? (int)(state->bytesSent * 1000LL / elapsed) : 0;
 		}
 	}
 
-	if(ucmd->buttons & KEY_MASK_FIRE && !(previousbuttons[clientnum] & KEY_MASK_FIRE))
+	snapshot->bpsTotalBytes = sv.bpsTotalBytes;
+	snapshot->ubpsTotalBytes = sv.ubpsTotalBytes;
+
+	snapshot->asyncExec = -1;
+	snapshot->asyncMysql = -1;
+	snapshot->asyncSqlite = -1;
+	snapshot->asyncResolver = -1;
+
+#if COMPILE_EXEC == 1
+	snapshot->asyncExec = exec_async_pending();
+#endif
+
+#if COMPILE_MYSQL_DEFAULT == 1
+	snapshot->asyncMysql = mysql_async_pending();
+#endif
+
+#if COMPILE_SQLITE == 1
+	snapshot->asyncSqlite = sqlite_async_pending();
+#endif
+
+#if COMPILE_RESOLVER == 1
+	snapshot->asyncResolver = net_resolver_pending();
+#endif
+
+#if COMPILE_RATELIMITER == 1 && ( COD_VERSION == COD2_1_0 || COD_VERSION == COD2_1_2 || COD_VERSION == COD2_1_3 )
+	for (int i = 0; i < RATELIMIT_COUNT && i < METRICS_MAX_RATELIMITS; i++)
 	{
-		if(codecallback_attackbutton)
-		{
-			short ret = Scr_ExecEntThread(cl->gentity, codecallback_attackbutton, 0);
-			Scr_FreeThread(ret);
-		}
+		metricsRateLimit_t *limit = &snapshot->rateLimits[snapshot->rateLimitCount++];
+
+		limit->name = rateLimitPolicies[i].name;
+		limit->served = rateLimitPolicies[i].served;
+		limit->droppedAddress = rateLimitPolicies[i].droppedAddress;
+		limit->droppedSubnet = rateLimitPolicies[i].droppedSubnet;
+		limit->droppedGlobal = rateLimitPolicies[i].droppedGlobal;
 	}
+#endif
 
-	previousbuttons[clientnum] = ucmd->buttons;
-	return ret;
+	snapshot->downloadBytesTotal = downloadBytesTotal;
+	snapshot->downloadClients = downloadClients;
+
+#if COMPILE_PERFSTATS == 1
+	perfStats_t frame;
+	perf_phase_stats(PERF_FRAME, &frame);
+
+	snapshot->frameSamples = frame.samples;
+	snapshot->frameAvg = frame.avg;
+	snapshot->frameP50 = frame.p50;
+	snapshot->frameP90 = frame.p90;
+	snapshot->frameP99 = frame.p99;
+	snapshot->frameMax = frame.max;
+#endif
+
+#if COMPILE_ASYNCLOG == 1
+	snapshot->consoleDropped = async_log_dropped();
+#endif
+
+#if COMPILE_EVENTLOG == 1
+	snapshot->eventsDropped = event_log_dropped();
+#endif
+
+	metrics_snapshot_publish();
 }
+#endif
 
-int player_g_speed[MAX_CLIENTS] = {0};
-int player_g_gravity[MAX_CLIENTS] = {0};
-cHook *hook_play_endframe;
-int play_endframe(gentity_t *ent)
+#if COMPILE_SHMSTATS == 1
+// Rewritten every frame, readers in other processes see it through their own mapping
+void SV_UpdateShmStats()
 {
-	hook_play_endframe->unhook();
+	static shmStats_t stats;
 
-	int (*sig)(gentity_t *ent);
-	*(int *)&sig = hook_play_endframe->from;
+	if (!shm_stats_running())
+		return;
 
-	int ret = sig(ent);
+	stats.frame++;
+	stats.serverTime = svs.time;
 
-	hook_play_endframe->hook();
+	cvar_t *mapname = Cvar_FindVar("mapname");
+	strncpy(stats.mapname, mapname ? mapname->string : "", sizeof(stats.mapname) - 1);
 
-	if (ent->client->sess.state == STATE_PLAYING)
+	stats.maxclients = sv_maxclients->integer < SHM_STATS_MAX_CLIENTS ? sv_maxclients->integer : SHM_STATS_MAX_CLIENTS;
+
+	for (int i = 0; i < stats.maxclients; i++)
 	{
-		int num = ent - g_entities;
+		client_t *cl = &svs.clients[i];
+		shmStatsClient_t *client = &stats.clients[i];
 
-		if (player_g_speed[num] > 0)
-			ent->client->ps.speed = player_g_speed[num];
+		memset(client, 0, sizeof(shmStatsClient_t));
 
-		if (player_g_gravity[num] > 0)
-			ent->client->ps.gravity = player_g_gravity[num];
+		if (cl->state < CS_CONNECTED)
+			continue;
+
+		client->state = cl->state;
+		client->bot = cl->netchan.remoteAddress.type == NA_BOT;
+		strncpy(client->name, cl->name, sizeof(client->name) - 1);
+		client->ping = cl->ping;
+
+		gclient_t *gclient = g_entities[i].client;
+
+		if (cl->state == CS_ACTIVE && gclient)
+		{
+			client->team = gclient->sess.team;
+			client->sessionState = gclient->sess.state;
+			client->score = gclient->sess.score;
+			client->deaths = gclient->sess.deaths;
+			VectorCopy(gclient->ps.origin, client->origin);
+		}
+
+#if COMPILE_PLAYER == 1
+		client->fps = clientfps[i];
+#endif
 	}
 
-	return ret;
+	shm_stats_publish(&stats);
 }
+#endif
 
-int custom_animation[MAX_CLIENTS] = {0};
-cHook *hook_set_anim;
-int set_anim(playerState_t *ps, int animNum, animBodyPart_t bodyPart, int forceDuration, qboolean setTimer, qboolean isContinue, qboolean force)
+#define MANYMAPS_HASH_SIZE 4096
+
+// Names in the map library, kept current with inotify instead of reading the directory on every map change
+typedef struct manymapsEntry_s
 {
-	hook_set_anim->unhook();
+	char *name;
+	struct manymapsEntry_s *next;
+} manymapsEntry_t;
+
+static manymapsEntry_t *manymapsIndex[MANYMAPS_HASH_SIZE];
+static char manymapsLibrary[512];
+static bool manymapsIndexed = false;
+static int manymapsNotify = -1;
+static bool manymapsCleaned = false; // links left by an earlier run were removed
+static char manymapsLink[512]; // link created for the current map
+
+static void manymaps_library_path(char *library_path, int size)
+{
+	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
+	cvar_t *fs_game = Cvar_FindVar("fs_game");
 
-	int (*sig)(playerState_t *ps, int animNum, animBodyPart_t bodyPart, int forceDuration, qboolean setTimer, qboolean isContinue, qboolean force);
-	*(int *)&sig = hook_set_anim->from;
+	if (strlen(fs_library->string))
+		snprintf(library_path, size, "%s", fs_library->string);
+	else
+		snprintf(library_path, size, "%s/%s/Library", fs_homepath->string, fs_game->string);
+}
 
-	int ret;
+static unsigned int manymaps_hash(const char *name)
+{
+	unsigned int hash = 5381;
 
-	if (!custom_animation[ps->clientNum])
-		ret = sig(ps, animNum, bodyPart, forceDuration, setTimer, isContinue, force);
-	else
-		ret = sig(ps, custom_animation[ps->clientNum], bodyPart, forceDuration, qtrue, isContinue, qtrue);
+	while (*name)
+		hash = hash * 33 + (unsigned char)*name++;
 
-	hook_set_anim->hook();
+	return hash & (MANYMAPS_HASH_SIZE - 1);
+}
 
-	return ret;
+static bool manymaps_index_has(const char *name)
+{
+	for (manymapsEntry_t *entry = manymapsIndex[manymaps_hash(name)]; entry != NULL; entry = entry->next)
+	{
+		if (strcmp(entry->name, name) == 0)
+			return true;
+	}
+
+	return false;
 }
-#endif
 
-#if COMPILE_RATELIMITER == 1
-// ioquake3 rate limit connectionless requests
-// https://github.com/ioquake/ioq3/blob/master/code/server/sv_main.c
+static void manymaps_index_add(const char *name)
+{
+	if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || manymaps_index_has(name))
+		return;
 
-// This is deliberately quite large to make it more of an effort to DoS
-#define MAX_BUCKETS	16384
-#define MAX_HASHES 1024
+	unsigned int hash = manymaps_hash(name);
+	manymapsEntry_t *entry = new manymapsEntry_t;
 
-static leakyBucket_t buckets[ MAX_BUCKETS ];
-static leakyBucket_t* bucketHashes[ MAX_HASHES ];
-leakyBucket_t outboundLeakyBucket;
+	entry->name = strdup(name);
+	entry->next = manymapsIndex[hash];
+	manymapsIndex[hash] = entry;
+}
 
-static long SVC_HashForAddress( netadr_t address )
+static void manymaps_index_remove(const char *name)
 {
-	unsigned char *ip = address.ip;
-	int	i;
-	long hash = 0;
+	for (manymapsEntry_t **link = &manymapsIndex[manymaps_hash(name)]; *link != NULL; link = &(*link)->next)
+	{
+		manymapsEntry_t *entry = *link;
 
-	for ( i = 0; i < 4; i++ )
+		if (strcmp(entry->name, name) == 0)
+		{
+			*link = entry->next;
+			free(entry->name);
+			delete entry;
+			return;
+		}
+	}
+}
+
+static void manymaps_index_clear()
+{
+	for (int i = 0; i < MANYMAPS_HASH_SIZE; i++)
 	{
-		hash += (long)( ip[ i ] ) * ( i + 119 );
+		while (manymapsIndex[i] != NULL)
+		{
+			manymapsEntry_t *entry = manymapsIndex[i];
+			manymapsIndex[i] = entry->next;
+			free(entry->name);
+			delete entry;
+		}
 	}
+}
 
-	hash = ( hash ^ ( hash >> 10 ) ^ ( hash >> 20 ) );
-	hash &= ( MAX_HASHES - 1 );
+static void manymaps_index_build(const char *library_path)
+{
+	manymaps_index_clear();
 
-	return hash;
+	if (manymapsNotify >= 0)
+		close(manymapsNotify);
+
+	// watch before reading so no change in between is lost
+	manymapsNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (manymapsNotify >= 0 && inotify_add_watch(manymapsNotify, library_path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+	{
+		close(manymapsNotify);
+		manymapsNotify = -1;
+	}
+
+	DIR *dir = opendir(library_path);
+
+	if (dir)
+	{
+		struct dirent *dir_ent;
+
+		while ((dir_ent = readdir(dir)) != NULL)
+			manymaps_index_add(dir_ent->d_name);
+
+		closedir(dir);
+	}
+
+	strncpy(manymapsLibrary, library_path, sizeof(manymapsLibrary) - 1);
+	manymapsLibrary[sizeof(manymapsLibrary) - 1] = '\0';
+
+	// without inotify the index is rebuilt on every use, as often as the directory used to be read
+	manymapsIndexed = manymapsNotify >= 0;
 }
 
-static leakyBucket_t *SVC_BucketForAddress( netadr_t address, int burst, int period )
-{
-	leakyBucket_t *bucket = NULL;
-	int	i;
-	long hash = SVC_HashForAddress( address );
-	int	now = Sys_MilliSeconds();
+static void manymaps_index_update(const char *library_path)
+{
+	if (!manymapsIndexed || strcmp(library_path, manymapsLibrary) != 0)
+	{
+		if (strcmp(library_path, manymapsLibrary) != 0)
+			manymapsCleaned = false;
+
+		manymaps_index_build(library_path);
+		return;
+	}
+
+	char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	int length;
+	bool rebuild = false;
 
-	for ( bucket = bucketHashes[ hash ]; bucket; bucket = bucket->next )
+	while ((length = read(manymapsNotify, events, sizeof(events))) > 0)
 	{
-		if ( memcmp( bucket->adr, address.ip, 4 ) == 0 )
+		for (char *ptr = events; ptr < events + length; ptr += sizeof(struct inotify_event) + ((struct inotify_event *)ptr)->len)
 		{
-			return bucket;
+			struct inotify_event *event = (struct inotify_event *)ptr;
+
+			if (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+				rebuild = true;
+			else if (event->len && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+				manymaps_index_add(event->name);
+			else if (event->len && (event->mask & (IN_DELETE | IN_MOVED_FROM)))
+				manymaps_index_remove(event->name);
 		}
 	}
 
-	for ( i = 0; i < MAX_BUCKETS; i++ )
-	{
-		int interval;
+	if (rebuild)
+		manymaps_index_build(library_path);
+}
 
-		bucket = &buckets[ i ];
-		interval = now - bucket->lastTime;
+static bool manymaps_library_has_map(const char *library_path, const char *mapname)
+{
+	char iwd[MAX_QPATH + 8];
 
-		// Reclaim expired buckets
-		if ( bucket->lastTime > 0 && ( interval > ( burst * period ) ||
-		                               interval < 0 ) )
-		{
-			if ( bucket->prev != NULL )
-			{
-				bucket->prev->next = bucket->next;
-			}
-			else
-			{
-				bucketHashes[ bucket->hash ] = bucket->next;
-			}
+	manymaps_index_update(library_path);
+	snprintf(iwd, sizeof(iwd), "%s.iwd", mapname);
 
-			if ( bucket->next != NULL )
-			{
-				bucket->next->prev = bucket->prev;
-			}
+	return manymaps_index_has(iwd);
+}
 
-			memset( bucket, 0, sizeof( leakyBucket_t ) );
-		}
+static int iwdStagingSpawn = 0; // server spawns so far, first part of the staging directory names
+static int iwdStagingCount = 0;
+static bool iwdStagingReady = false;
 
-		if ( bucket->type == 0 )
-		{
-			bucket->type = address.type;
-			memcpy( bucket->adr, address.ip, 4 );
+static void FS_RemoveTree(const char *path)
+{
+	DIR *dir = opendir(path);
 
-			bucket->lastTime = now;
-			bucket->burst = 0;
-			bucket->hash = hash;
+	if (dir != NULL)
+	{
+		struct dirent *dir_ent;
+		struct stat st;
+		char child[MAX_OSPATH * 2];
 
-			// Add to the head of the relevant hash chain
-			bucket->next = bucketHashes[ hash ];
-			if ( bucketHashes[ hash ] != NULL )
-			{
-				bucketHashes[ hash ]->prev = bucket;
-			}
+		while ((dir_ent = readdir(dir)) != NULL)
+		{
+			if (strcmp(dir_ent->d_name, ".") == 0 || strcmp(dir_ent->d_name, "..") == 0)
+				continue;
 
-			bucket->prev = NULL;
-			bucketHashes[ hash ] = bucket;
+			snprintf(child, sizeof(child), "%s/%s", path, dir_ent->d_name);
 
-			return bucket;
+			if (lstat(child, &st) == 0 && S_ISDIR(st.st_mode))
+				FS_RemoveTree(child);
+			else
+				unlink(child);
 		}
+
+		closedir(dir);
 	}
 
-	// Couldn't allocate a bucket for this address
-	return NULL;
+	rmdir(path);
 }
 
-bool SVC_RateLimit( leakyBucket_t *bucket, int burst, int period )
+// The engine keeps every pack it added open, counting the descriptors on the file tells whether FS_LoadDir took it
+static int FS_OpenCount(const char *target)
 {
-	if ( bucket != NULL )
+	DIR *fds = opendir("/proc/self/fd");
+
+	if (fds == NULL)
+		return 0;
+
+	struct dirent *dir_ent;
+	char fd[64];
+	char path[MAX_OSPATH * 2];
+	int count = 0;
+
+	while ((dir_ent = readdir(fds)) != NULL)
 	{
-		int now = Sys_MilliSeconds();
-		int interval = now - bucket->lastTime;
-		int expired = interval / period;
-		int expiredRemainder = interval % period;
+		if (dir_ent->d_name[0] == '.')
+			continue;
 
-		if ( expired > bucket->burst || interval < 0 )
-		{
-			bucket->burst = 0;
-			bucket->lastTime = now;
-		}
-		else
-		{
-			bucket->burst -= expired;
-			bucket->lastTime = now - expiredRemainder;
-		}
+		snprintf(fd, sizeof(fd), "/proc/self/fd/%s", dir_ent->d_name);
 
-		if ( bucket->burst < burst )
-		{
-			bucket->burst++;
+		int length = readlink(fd, path, sizeof(path) - 1);
 
-			return false;
-		}
+		if (length <= 0)
+			continue;
+
+		path[length] = '\0';
+
+		if (strcmp(path, target) == 0)
+			count++;
 	}
 
-	return true;
+	closedir(fds);
+
+	return count;
 }
 
-bool SVC_RateLimitAddress( netadr_t from, int burst, int period )
+// Called when the server spawns. The filesystem reset dropped packs registered before the
+// previous spawn, their staging directories go. The previous generation stays because
+// manymaps registers the iwd of the new map just before the spawn.
+void FS_ClearIwdStaging()
 {
-	leakyBucket_t *bucket = SVC_BucketForAddress( from, burst, period );
+	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
 
-	return SVC_RateLimit( bucket, burst, period );
-}
+	iwdStagingSpawn++;
 
-void hook_SVC_RemoteCommand(netadr_t from, msg_t *msg)
-{
-	if (!sv_allowRcon->boolean)
+	if (fs_homepath == NULL || !iwdStagingReady)
 		return;
 
-	// Prevent using rcon as an amplifier and make dictionary attacks impractical
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) )
-	{
-		Com_DPrintf( "SVC_RemoteCommand: rate limit from %s exceeded, dropping request\n", NET_AdrToString( from ) );
-		return;
-	}
+	char root[MAX_OSPATH];
+	char path[MAX_OSPATH * 2];
 
-	bool badRconPassword = !strlen( rcon_password->string ) || strcmp(Cmd_Argv(1), rcon_password->string) != 0;
-	if (badRconPassword)
-	{
-		static leakyBucket_t bucket;
+	snprintf(root, sizeof(root), "%s/.iwdstaging", fs_homepath->string);
 
-		// Make DoS via rcon impractical
-		if ( SVC_RateLimit( &bucket, 10, 1000 ) )
-		{
-			Com_DPrintf( "SVC_RemoteCommand: rate limit exceeded, dropping request\n" );
-			return;
-		}
-	}
+	DIR *stage = opendir(root);
 
-	if (!codecallback_remotecommand || badRconPassword || !Scr_IsSystemActive() || strcmp(Cmd_Argv(2), "map") == 0 || strcmp(Cmd_Argv(2), "devmap") == 0)
-	{
-		RemoteCommand(from, msg);
-	}
-	else
-	{
-		stackPushInt((int)msg);
+	if (stage == NULL)
+		return;
 
-		stackPushArray();
-		int args = Cmd_Argc();
-		for (int i = 2; i < args; i++)
-		{
-			char tmp[MAX_STRINGLENGTH];
-			SV_Cmd_ArgvBuffer(i, tmp, sizeof(tmp));
-			stackPushString(tmp);
-			stackPushArrayLast();
-		}
+	struct dirent *dir_ent;
 
-		stackPushString(NET_AdrToString(from));
-	
-		short ret = Scr_ExecThread(codecallback_remotecommand, 3);
-		Scr_FreeThread(ret);
+	while ((dir_ent = readdir(stage)) != NULL)
+	{
+		if (dir_ent->d_name[0] == '.' || atoi(dir_ent->d_name) >= iwdStagingSpawn - 1)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", root, dir_ent->d_name);
+		FS_RemoveTree(path);
 	}
+
+	closedir(stage);
 }
 
-void hook_SV_GetChallenge(netadr_t from)
+// mkdir -p, the components of fs_game like mods/<name> are created one by one
+static void FS_CreatePath(const char *path)
 {
-	// Prevent using getchallenge as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) )
-	{
-		Com_DPrintf( "SV_GetChallenge: rate limit from %s exceeded, dropping request\n", NET_AdrToString( from ) );
-		return;
-	}
+	char partial[MAX_OSPATH * 3];
 
-	// Allow getchallenge to be DoSed relatively easily, but prevent
-	// excess outbound bandwidth usage when being flooded inbound
-	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) )
+	snprintf(partial, sizeof(partial), "%s", path);
+
+	for (char *slash = strchr(partial + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
 	{
-		Com_DPrintf( "SV_GetChallenge: rate limit exceeded, dropping request\n" );
-		return;
+		*slash = '\0';
+		mkdir(partial, 0755);
+		*slash = '/';
 	}
 
-	SV_GetChallenge(from);
+	mkdir(partial, 0755);
 }
 
-void hook_SVC_Info(netadr_t from)
+// FS_LoadDir adds every iwd of the directory it is given, so it is pointed at a staging
+// directory of its own that only links the new iwd. The pack keeps "<dir>/<name>" as its
+// reference, pure checks and downloads see the same name as with a full rescan.
+// Links stay while the pack is in the search path, the engine may reopen it by name.
+int FS_LoadIwd(const char *dir, const char *file)
 {
-	// Prevent using getinfo as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) )
-	{
-		Com_DPrintf( "SVC_Info: rate limit from %s exceeded, dropping request\n", NET_AdrToString( from ) );
-		return;
-	}
+	char root[MAX_OSPATH];
+	char staging[MAX_OSPATH * 2];
+	char gamedir[MAX_OSPATH * 3];
+	char link[MAX_OSPATH * 4];
 
-	// Allow getinfo to be DoSed relatively easily, but prevent
-	// excess outbound bandwidth usage when being flooded inbound
-	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) )
+	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
+	const char *name = strrchr(file, '/');
+
+	name = name ? name + 1 : file;
+
+	if (fs_homepath == NULL || !*dir || *dir == '/' || strstr(dir, "..") || strlen(name) < 5 || strcmp(&name[strlen(name) - 4], ".iwd") != 0)
+		return 0;
+
+	snprintf(root, sizeof(root), "%s/.iwdstaging", fs_homepath->string);
+
+	// directories left by an earlier run would collide with the names of this one
+	if (!iwdStagingReady)
 	{
-		Com_DPrintf( "SVC_Info: rate limit exceeded, dropping request\n" );
-		return;
+		FS_RemoveTree(root);
+		iwdStagingReady = true;
 	}
 
-	SVC_Info(from);
-}
+	snprintf(staging, sizeof(staging), "%s/%i_%i", root, iwdStagingSpawn, iwdStagingCount++);
+	snprintf(gamedir, sizeof(gamedir), "%s/%s", staging, dir);
+	snprintf(link, sizeof(link), "%s/%s", gamedir, name);
 
-void hook_SVC_Status(netadr_t from)
-{
-	// Prevent using getstatus as an amplifier
-	if ( SVC_RateLimitAddress( from, 10, 1000 ) )
+	FS_CreatePath(gamedir);
+
+	// the link has to work from the staging directory, relative paths would not
+	char *target = realpath(file, NULL);
+
+	if (target == NULL)
 	{
-		Com_DPrintf( "SVC_Status: rate limit from %s exceeded, dropping request\n", NET_AdrToString( from ) );
-		return;
+		FS_RemoveTree(staging);
+		return 0;
 	}
 
-	// Allow getstatus to be DoSed relatively easily, but prevent
-	// excess outbound bandwidth usage when being flooded inbound
-	if ( SVC_RateLimit( &outboundLeakyBucket, 10, 100 ) )
+	if (symlink(target, link) != 0)
 	{
-		Com_DPrintf( "SVC_Status: rate limit exceeded, dropping request\n" );
-		return;
+		free(target);
+		FS_RemoveTree(staging);
+		return 0;
 	}
 
-	SVC_Status(from);
+	int opened = FS_OpenCount(target);
+
+	FS_LoadDir(staging, (char *)dir);
+
+	int loaded = FS_OpenCount(target) > opened;
+	free(target);
+
+	if (!loaded)
+		FS_RemoveTree(staging);
+
+	return loaded;
 }
-#endif
 
 void manymaps_prepare(const char *mapname, int read)
 {
-	char map_check[1024];
 	char library_path[512];
 
 	cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
 	cvar_t *fs_game = Cvar_FindVar("fs_game");
 	cvar_t *map = Cvar_FindVar("mapname");
 
-	if (strlen(fs_library->string))
-		strncpy(library_path, fs_library->string, sizeof(library_path));
-	else
-		snprintf(library_path, sizeof(library_path), "%s/%s/Library", fs_homepath->string, fs_game->string);
-
-	snprintf(map_check, sizeof(map_check), "%s/%s.iwd", library_path, mapname);
+	manymaps_library_path(library_path, sizeof(library_path));
 
 #if COD_VERSION == COD2_1_0
 	const char *stock_maps[] = { "mp_breakout", "mp_brecourt", "mp_burgundy", "mp_carentan", "mp_dawnville", "mp_decoy", "mp_downtown", "mp_farmhouse", "mp_leningrad", "mp_matmata", "mp_railyard", "mp_toujane", "mp_trainstation" };
@@ -1209,57 +3124,259 @@ void manymaps_prepare(const char *mapname, int read)
 		}
 	}
 
-	int map_exists = access(map_check, F_OK) != -1;
+	int map_exists = manymaps_library_has_map(library_path, mapname);
 
 	if (!map_exists && !map_found)
 		return;
 
-	DIR *dir;
-	struct dirent *dir_ent;
+	if (!manymapsCleaned)
+	{
+		// Links from an earlier run can be anywhere, check every library entry once
+		for (int i = 0; i < MANYMAPS_HASH_SIZE; i++)
+		{
+			for (manymapsEntry_t *entry = manymapsIndex[i]; entry != NULL; entry = entry->next)
+			{
+				char fileDelete[512];
+				snprintf(fileDelete, sizeof(fileDelete), "%s/%s/%s", fs_homepath->string, fs_game->string, entry->name);
 
-	dir = opendir(library_path);
+				if (access(fileDelete, F_OK) != -1)
+				{
+					int unlink_success = unlink(fileDelete) == 0;
+					printf("manymaps> REMOVED OLD LINK: %s result of unlink: %s\n", fileDelete, unlink_success?"success":"failed");
+				}
+			}
+		}
 
-	if (!dir)
-		return;
+		manymapsCleaned = true;
+	}
+	else if (*manymapsLink)
+	{
+		// Only the link of the previous map is left
+		int unlink_success = unlink(manymapsLink) == 0;
+		printf("manymaps> REMOVED OLD LINK: %s result of unlink: %s\n", manymapsLink, unlink_success?"success":"failed");
+	}
+
+	*manymapsLink = 0;
+
+	if (map_exists)
+	{
+		char src[1024];
+		char dst[512];
+
+		snprintf(src, sizeof(src), "%s/%s.iwd", library_path, mapname);
+		snprintf(dst, sizeof(dst), "%s/%s/%s.iwd", fs_homepath->string, fs_game->string, mapname);
+
+		int link_success = symlink(src, dst) == 0;
+		printf("manymaps> NEW LINK: src=%s dst=%s result of link: %s\n", src, dst, link_success?"success":"failed");
+
+		if (link_success)
+			strncpy(manymapsLink, dst, sizeof(manymapsLink) - 1);
+
+		// Registering is needed when empty.iwd is missing (then .d3dbsp isn't referenced anywhere)
+		if (link_success && read == -1 && !FS_LoadIwd(fs_game->string, src))
+		{
+			printf("manymaps> %s.iwd not registered alone, rescanning %s\n", mapname, fs_game->string);
+			FS_LoadDir(fs_homepath->string, fs_game->string);
+		}
+	}
+}
+
+#define MANYMAPS_PRELOAD_CHUNK ( 4 * 1024 * 1024 )
+
+// Iwd of the map played next, read into the page cache so the switch does not load it cold
+typedef struct
+{
+	char mapname[MAX_QPATH];
+	char path[1024];
+	bool pending; // posted, not picked up by the thread yet
+	bool running;
+	bool finished; // reported by the main thread
+	int warmed; // bytes in the page cache
+	int total;
+	int startTime;
+} manymapsPreload_t;
+
+static manymapsPreload_t manymapsPreload;
+static pthread_mutex_t manymapsPreloadMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t manymapsPreloadCond = PTHREAD_COND_INITIALIZER;
+static bool manymapsPreloadStarted = false;
+
+static void *manymaps_preload_thread(void *unused)
+{
+	char path[1024];
+
+	pthread_mutex_lock(&manymapsPreloadMutex);
 
-	while ((dir_ent = readdir(dir)) != NULL)
+	while (true)
 	{
-		if (strcmp(dir_ent->d_name, ".") == 0 || strcmp(dir_ent->d_name, "..") == 0)
+		if (!manymapsPreload.pending)
+		{
+			pthread_cond_wait(&manymapsPreloadCond, &manymapsPreloadMutex);
 			continue;
+		}
+
+		strcpy(path, manymapsPreload.path);
+		manymapsPreload.pending = false;
+		manymapsPreload.running = true;
+		manymapsPreload.warmed = 0;
+		manymapsPreload.total = 0;
+
+		pthread_mutex_unlock(&manymapsPreloadMutex);
+
+		int fd = open(path, O_RDONLY);
+		struct stat st;
+
+		if (fd >= 0 && fstat(fd, &st) == 0)
+		{
+			pthread_mutex_lock(&manymapsPreloadMutex);
+			manymapsPreload.total = st.st_size;
+			pthread_mutex_unlock(&manymapsPreloadMutex);
+
+			posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+			for (off_t offset = 0; offset < st.st_size; offset += MANYMAPS_PRELOAD_CHUNK)
+			{
+				int length = st.st_size - offset < MANYMAPS_PRELOAD_CHUNK ? st.st_size - offset : MANYMAPS_PRELOAD_CHUNK;
 
-		char fileDelete[512];
-		snprintf(fileDelete, sizeof(fileDelete), "%s/%s/%s", fs_homepath->string, fs_game->string, dir_ent->d_name);
+				if (readahead(fd, offset, length) != 0)
+					break;
 
-		if (access(fileDelete, F_OK) != -1)
+				pthread_mutex_lock(&manymapsPreloadMutex);
+				manymapsPreload.warmed += length;
+				bool superseded = manymapsPreload.pending;
+				pthread_mutex_unlock(&manymapsPreloadMutex);
+
+				if (superseded)
+					break;
+			}
+		}
+
+		if (fd >= 0)
+			close(fd);
+
+		pthread_mutex_lock(&manymapsPreloadMutex);
+		manymapsPreload.running = false;
+		manymapsPreload.finished = true;
+	}
+
+	return NULL;
+}
+
+int manymaps_preload(const char *mapname)
+{
+	char library_path[512];
+
+	manymaps_library_path(library_path, sizeof(library_path));
+
+	// stock maps live in the game's own iwds
+	if (!manymaps_library_has_map(library_path, mapname))
+		return 0;
+
+	pthread_mutex_lock(&manymapsPreloadMutex);
+
+	if (!manymapsPreloadStarted)
+	{
+		pthread_t preload_thread;
+
+		if (pthread_create(&preload_thread, NULL, manymaps_preload_thread, NULL) != 0 || pthread_detach(preload_thread) != 0)
 		{
-			int unlink_success = unlink(fileDelete) == 0;
-			printf("manymaps> REMOVED OLD LINK: %s result of unlink: %s\n", fileDelete, unlink_success?"success":"failed");
+			pthread_mutex_unlock(&manymapsPreloadMutex);
+			Com_Printf("manymaps_preload() error creating preload thread!\n");
+			return 0;
 		}
+
+		manymapsPreloadStarted = true;
 	}
 
-	closedir(dir);
+	// already warm or warming
+	if (strcmp(manymapsPreload.mapname, mapname) == 0 && (manymapsPreload.pending || manymapsPreload.running || (manymapsPreload.total > 0 && manymapsPreload.warmed == manymapsPreload.total)))
+	{
+		pthread_mutex_unlock(&manymapsPreloadMutex);
+		return 1;
+	}
 
-	if (map_exists)
+	snprintf(manymapsPreload.mapname, sizeof(manymapsPreload.mapname), "%s", mapname);
+	snprintf(manymapsPreload.path, sizeof(manymapsPreload.path), "%s/%s.iwd", library_path, mapname);
+	manymapsPreload.pending = true;
+	manymapsPreload.finished = false;
+	manymapsPreload.startTime = Sys_MilliSeconds();
+
+	pthread_cond_signal(&manymapsPreloadCond);
+	pthread_mutex_unlock(&manymapsPreloadMutex);
+
+	return 1;
+}
+
+// Returns 0 when nothing was preloaded yet
+int manymaps_preload_status(char *mapname, int size, int *warmed, int *total)
+{
+	pthread_mutex_lock(&manymapsPreloadMutex);
+
+	int found = *manymapsPreload.mapname != '\0';
+
+	snprintf(mapname, size, "%s", manymapsPreload.mapname);
+	*warmed = manymapsPreload.warmed;
+	*total = manymapsPreload.total;
+
+	pthread_mutex_unlock(&manymapsPreloadMutex);
+
+	return found;
+}
+
+void manymaps_preload_report()
+{
+	if (!manymapsPreloadStarted)
+		return;
+
+	pthread_mutex_lock(&manymapsPreloadMutex);
+
+	if (manymapsPreload.finished)
 	{
-		char src[1024];
-		char dst[512];
+		manymapsPreload.finished = false;
+		printf("manymaps> PRELOADED: %s %i of %i bytes in %i ms\n", manymapsPreload.mapname, manymapsPreload.warmed, manymapsPreload.total, Sys_MilliSeconds() - manymapsPreload.startTime);
+	}
 
-		snprintf(src, sizeof(src), "%s/%s.iwd", library_path, mapname);
-		snprintf(dst, sizeof(dst), "%s/%s/%s.iwd", fs_homepath->string, fs_game->string, mapname);
+	pthread_mutex_unlock(&manymapsPreloadMutex);
+}
+
+// The map after this one is the first in sv_maprotationcurrent, or in sv_maprotation once that ran out
+void manymaps_preload_next()
+{
+	const char *rotations[] = { "sv_maprotationcurrent", "sv_maprotation" };
 
-		if (access(src, F_OK) != -1)
+	for (int i = 0; i < 2; i++)
+	{
+		cvar_t *rotation = Cvar_FindVar(rotations[i]);
+
+		if (rotation == NULL || !*rotation->string)
+			continue;
+
+		char buffer[MAX_STRINGLENGTH];
+		char *token;
+		bool next = false;
+
+		snprintf(buffer, sizeof(buffer), "%s", rotation->string);
+
+		for (token = strtok(buffer, " \t"); token != NULL; token = strtok(NULL, " \t"))
 		{
-			int link_success = symlink(src, dst) == 0;
-			printf("manymaps> NEW LINK: src=%s dst=%s result of link: %s\n", src, dst, link_success?"success":"failed");
+			if (next)
+			{
+				manymaps_preload(token);
+				return;
+			}
 
-			if (link_success && read == -1) // FS_LoadDir is needed when empty.iwd is missing (then .d3dbsp isn't referenced anywhere)
-				FS_LoadDir(fs_homepath->string, fs_game->string);
+			next = strcmp(token, "map") == 0;
 		}
 	}
 }
 
 int hook_findMap(const char *qpath, void **buffer)
 {
+#if COMPILE_WATCHDOG == 1
+	// loading a map is expected to take a while
+	watchdog_suspend();
+#endif
+
 	int read = FS_ReadFile(qpath, buffer);
 	manymaps_prepare(Cmd_Argv(1), read);
 
@@ -1279,19 +3396,11 @@ bool hook_SV_MapExists(const char *mapname)
 	}
 	else 
 	{
-		char map_check[1024];
 		char library_path[512];
 
-		cvar_t *fs_homepath = Cvar_FindVar("fs_homepath");
-		cvar_t *fs_game = Cvar_FindVar("fs_game");
-		if (strlen(fs_library->string))
-			strncpy(library_path, fs_library->string, sizeof(library_path));
-		else
-			snprintf(library_path, sizeof(library_path), "%s/%s/Library", fs_homepath->string, fs_game->string);
-
-		snprintf(map_check, sizeof(map_check), "%s/%s.iwd", library_path, mapname);
+		manymaps_library_path(library_path, sizeof(library_path));
 
-		return access(map_check, F_OK) != -1;
+		return manymaps_library_has_map(library_path, mapname);
 	}
 }
 
@@ -1303,8 +3412,14 @@ public:
 		// dont inherit lib of parent
 		unsetenv("LD_PRELOAD");
 
+#if COMPILE_ASYNCLOG == 1
+		// console output is copied into a ring buffer and written by a background thread
+		if (!async_log_start())
+			setbuf(stdout, NULL);
+#else
 		// otherwise the printf()'s are printed at crash/end on older os/compiler versions
 		setbuf(stdout, NULL);
+#endif
 
 #if COD_VERSION == COD2_1_0
 		printf("> [LIBCOD] Compiled for: CoD2 1.0\n");
@@ -1318,6 +3433,8 @@ public:
 
 		printf("> [LIBCOD] Compiled %s %s using GCC %s\n", __DATE__, __TIME__, __VERSION__);
 
+		Scr_InitCustomFunctions();
+
 		// allow to write in executable memory
 		mprotect((void *)0x08048000, 0x135000, PROT_READ | PROT_WRITE | PROT_EXEC);
 
@@ -0,0 +1,391 @@
+#include "metrics.hpp"
+
+#if COMPILE_METRICS == 1
+
+#include <pthread.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Triple buffer: the game thread fills back, publishing swaps it with middle,
+// the metrics thread swaps front with middle when a fresh snapshot is there
+#define METRICS_FRESH 4
+
+static metricsSnapshot_t metrics_snapshots[3];
+static int metrics_back = 0; // game thread
+static int metrics_middle = 1; // shared, index | METRICS_FRESH
+static int metrics_front = 2; // metrics thread
+
+static int metrics_listener = -1; // replaced by the game thread, the metrics thread closes the old one
+static bool metrics_thread_started = false;
+static char metrics_unix_path[108]; // sun_path of the current Unix socket
+
+metricsSnapshot_t *metrics_snapshot_begin()
+{
+	metricsSnapshot_t *snapshot = &metrics_snapshots[metrics_back];
+	memset(snapshot, 0, sizeof(metricsSnapshot_t));
+
+	return snapshot;
+}
+
+void metrics_snapshot_publish()
+{
+	metrics_snapshots[metrics_back].valid = 1;
+	metrics_back = __atomic_exchange_n(&metrics_middle, metrics_back | METRICS_FRESH, __ATOMIC_ACQ_REL) & 3;
+}
+
+static const metricsSnapshot_t *metrics_snapshot_latest()
+{
+	if (__atomic_load_n(&metrics_middle, __ATOMIC_ACQUIRE) & METRICS_FRESH)
+		metrics_front = __atomic_exchange_n(&metrics_middle, metrics_front, __ATOMIC_ACQ_REL) & 3;
+
+	return &metrics_snapshots[metrics_front];
+}
+
+static void metrics_append(char *buffer, int *length, const char *format, ...)
+{
+	if (*length >= METRICS_BUFFER_SIZE)
+		return;
+
+	va_list va;
+	va_start(va, format);
+	*length += vsnprintf(buffer + *length, METRICS_BUFFER_SIZE - *length, format, va);
+	va_end(va);
+}
+
+// Label values have to be UTF-8, player names are any bytes. Only printable ASCII is kept,
+// everything else becomes '?'
+static void metrics_escape(char *out, int size, const char *in)
+{
+	int length = 0;
+
+	for (; *in && length < size - 2; in++)
+	{
+		unsigned char c = *in;
+
+		if (c == '\\' || c == '"')
+			out[length++] = '\\';
+		else if (c < 0x20 || c > 0x7e)
+			c = '?';
+
+		out[length++] = c;
+	}
+
+	out[length] = '\0';
+}
+
+static int metrics_format(const metricsSnapshot_t *snapshot, char *buffer)
+{
+	int length = 0;
+	int active = 0, connected = 0, bots = 0;
+
+	for (int i = 0; i < snapshot->maxclients; i++)
+	{
+		if (snapshot->clients[i].state >= CS_CONNECTED)
+			connected++;
+
+		if (snapshot->clients[i].state == CS_ACTIVE)
+			active++;
+
+		if (snapshot->clients[i].state >= CS_CONNECTED && snapshot->clients[i].bot)
+			bots++;
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_players gauge\n");
+	metrics_append(buffer, &length, "cod_players{state=\"active\"} %i\n", active);
+	metrics_append(buffer, &length, "cod_players{state=\"connected\"} %i\n", connected);
+	metrics_append(buffer, &length, "cod_players{state=\"bot\"} %i\n", bots);
+	metrics_append(buffer, &length, "# TYPE cod_maxclients gauge\ncod_maxclients %i\n", snapshot->maxclients);
+
+	metrics_append(buffer, &length, "# TYPE cod_client_ping_ms gauge\n");
+
+	for (int i = 0; i < snapshot->maxclients; i++)
+	{
+		const metricsClient_t *client = &snapshot->clients[i];
+		char name[sizeof(client->name) * 2];
+
+		if (client->state != CS_ACTIVE || client->bot)
+			continue;
+
+		metrics_escape(name, sizeof(name), client->name);
+		metrics_append(buffer, &length, "cod_client_ping_ms{slot=\"%i\",name=\"%s\"} %i\n", i, name, client->ping);
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_client_rate_bytes gauge\n");
+
+	for (int i = 0; i < snapshot->maxclients; i++)
+	{
+		const metricsClient_t *client = &snapshot->clients[i];
+		char name[sizeof(client->name) * 2];
+
+		if (client->state < CS_CONNECTED || client->bot)
+			continue;
+
+		metrics_escape(name, sizeof(name), client->name);
+		metrics_append(buffer, &length, "cod_client_rate_bytes{slot=\"%i\",name=\"%s\"} %i\n", i, name, client->rate);
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_client_download_bytes_per_second gauge\n");
+
+	for (int i = 0; i < snapshot->maxclients; i++)
+	{
+		const metricsClient_t *client = &snapshot->clients[i];
+
+		if (client->downloading)
+			metrics_append(buffer, &length, "cod_client_download_bytes_per_second{slot=\"%i\"} %i\n", i, client->downloadRate);
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_bps_total_bytes gauge\ncod_bps_total_bytes %i\n", snapshot->bpsTotalBytes);
+	metrics_append(buffer, &length, "# TYPE cod_ubps_total_bytes gauge\ncod_ubps_total_bytes %i\n", snapshot->ubpsTotalBytes);
+
+	metrics_append(buffer, &length, "# TYPE cod_async_queue_depth gauge\n");
+
+	if (snapshot->asyncExec >= 0)
+		metrics_append(buffer, &length, "cod_async_queue_depth{module=\"exec\"} %i\n", snapshot->asyncExec);
+
+	if (snapshot->asyncMysql >= 0)
+		metrics_append(buffer, &length, "cod_async_queue_depth{module=\"mysql\"} %i\n", snapshot->asyncMysql);
+
+	if (snapshot->asyncSqlite >= 0)
+		metrics_append(buffer, &length, "cod_async_queue_depth{module=\"sqlite\"} %i\n", snapshot->asyncSqlite);
+
+	if (snapshot->asyncResolver >= 0)
+		metrics_append(buffer, &length, "cod_async_queue_depth{module=\"resolver\"} %i\n", snapshot->asyncResolver);
+
+	metrics_append(buffer, &length, "# TYPE cod_ratelimit_served_total counter\n");
+
+	for (int i = 0; i < snapshot->rateLimitCount; i++)
+		metrics_append(buffer, &length, "cod_ratelimit_served_total{command=\"%s\"} %u\n", snapshot->rateLimits[i].name, snapshot->rateLimits[i].served);
+
+	metrics_append(buffer, &length, "# TYPE cod_ratelimit_dropped_total counter\n");
+
+	for (int i = 0; i < snapshot->rateLimitCount; i++)
+	{
+		const metricsRateLimit_t *limit = &snapshot->rateLimits[i];
+
+		metrics_append(buffer, &length, "cod_ratelimit_dropped_total{command=\"%s\",bucket=\"address\"} %u\n", limit->name, limit->droppedAddress);
+		metrics_append(buffer, &length, "cod_ratelimit_dropped_total{command=\"%s\",bucket=\"subnet\"} %u\n", limit->name, limit->droppedSubnet);
+		metrics_append(buffer, &length, "cod_ratelimit_dropped_total{command=\"%s\",bucket=\"global\"} %u\n", limit->name, limit->droppedGlobal);
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_download_bytes_total counter\ncod_download_bytes_total %u\n", snapshot->downloadBytesTotal);
+	metrics_append(buffer, &length, "# TYPE cod_download_clients gauge\ncod_download_clients %i\n", snapshot->downloadClients);
+
+	if (snapshot->frameSamples > 0)
+	{
+		metrics_append(buffer, &length, "# TYPE cod_frame_interval_seconds summary\n");
+		metrics_append(buffer, &length, "cod_frame_interval_seconds{quantile=\"0.5\"} %.6f\n", snapshot->frameP50 / 1000000.0);
+		metrics_append(buffer, &length, "cod_frame_interval_seconds{quantile=\"0.9\"} %.6f\n", snapshot->frameP90 / 1000000.0);
+		metrics_append(buffer, &length, "cod_frame_interval_seconds{quantile=\"0.99\"} %.6f\n", snapshot->frameP99 / 1000000.0);
+		metrics_append(buffer, &length, "cod_frame_interval_seconds{quantile=\"1\"} %.6f\n", snapshot->frameMax / 1000000.0);
+		metrics_append(buffer, &length, "cod_frame_interval_seconds_sum %.6f\n", (double)snapshot->frameAvg * snapshot->frameSamples / 1000000.0);
+		metrics_append(buffer, &length, "cod_frame_interval_seconds_count %i\n", snapshot->frameSamples);
+	}
+
+	metrics_append(buffer, &length, "# TYPE cod_console_dropped_lines_total counter\ncod_console_dropped_lines_total %u\n", snapshot->consoleDropped);
+	metrics_append(buffer, &length, "# TYPE cod_events_dropped_total counter\ncod_events_dropped_total %u\n", snapshot->eventsDropped);
+
+	return length < METRICS_BUFFER_SIZE ? length : METRICS_BUFFER_SIZE - 1;
+}
+
+static void metrics_send(int fd, const char *data, int length)
+{
+	while (length > 0)
+	{
+		int sent = send(fd, data, length, MSG_NOSIGNAL);
+
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return;
+		}
+
+		data += sent;
+		length -= sent;
+	}
+}
+
+static void *metrics_thread(void *unused)
+{
+	static char body[METRICS_BUFFER_SIZE];
+	char request[1024];
+	char header[256];
+
+	int listener = -1;
+
+	while (true)
+	{
+		int current = __atomic_load_n(&metrics_listener, __ATOMIC_ACQUIRE);
+
+		if (current != listener)
+		{
+			if (listener >= 0)
+				close(listener);
+
+			listener = current;
+		}
+
+		if (listener < 0)
+		{
+			usleep(100000);
+			continue;
+		}
+
+		int fd = accept(listener, NULL, NULL);
+
+		if (fd < 0)
+		{
+			// EINVAL once metrics_stop() shut the listener down
+			if (errno != EINTR && errno != EINVAL)
+				usleep(100000);
+
+			continue;
+		}
+
+		// a scraper that connects and says nothing must not hold up the next one
+		struct timeval timeout = { 1, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		int received = 0;
+
+		while (received < (int)sizeof(request) - 1)
+		{
+			int count = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+
+			if (count <= 0)
+				break;
+
+			received += count;
+			request[received] = '\0';
+
+			if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+				break;
+		}
+
+		const metricsSnapshot_t *snapshot = metrics_snapshot_latest();
+		int length = snapshot->valid ? metrics_format(snapshot, body) : 0;
+
+		int headerLength = snprintf(header, sizeof(header),
+		                            "HTTP/1.0 %s\r\n"
+		                            "Content-Type: text/plain; version=0.0.4\r\n"
+		                            "Content-Length: %i\r\n"
+		                            "Connection: close\r\n"
+		                            "\r\n",
+		                            snapshot->valid ? "200 OK" : "503 Service Unavailable", length);
+
+		metrics_send(fd, header, headerLength);
+		metrics_send(fd, body, length);
+
+		close(fd);
+	}
+
+	return NULL;
+}
+
+int metrics_running()
+{
+	return __atomic_load_n(&metrics_listener, __ATOMIC_ACQUIRE) >= 0;
+}
+
+// The metrics thread wakes up from accept() and closes the socket itself
+void metrics_stop()
+{
+	int listener = __atomic_exchange_n(&metrics_listener, -1, __ATOMIC_ACQ_REL);
+
+	if (listener < 0)
+		return;
+
+	shutdown(listener, SHUT_RDWR);
+
+	if (*metrics_unix_path)
+	{
+		unlink(metrics_unix_path);
+		*metrics_unix_path = '\0';
+	}
+
+	Com_Printf("Metrics endpoint closed\n");
+}
+
+// address is a port on 127.0.0.1, or unix:<path> for a Unix socket. A running endpoint moves to the new address
+int metrics_start(const char *address)
+{
+	metrics_stop();
+
+	int fd;
+
+	if (strncmp(address, "unix:", 5) == 0)
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, address + 5, sizeof(addr.sun_path) - 1);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			return 0;
+
+		// left behind by an earlier run
+		unlink(addr.sun_path);
+
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+		{
+			Com_Printf("metrics_start() could not listen on %s: %s\n", address, strerror(errno));
+			close(fd);
+			return 0;
+		}
+
+		strcpy(metrics_unix_path, addr.sun_path);
+	}
+	else
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(atoi(address));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (fd < 0)
+			return 0;
+
+		int reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+		{
+			Com_Printf("metrics_start() could not listen on 127.0.0.1:%s: %s\n", address, strerror(errno));
+			close(fd);
+			return 0;
+		}
+	}
+
+	if (!metrics_thread_started)
+	{
+		pthread_t server;
+
+		if (pthread_create(&server, NULL, metrics_thread, NULL) != 0 || pthread_detach(server) != 0)
+		{
+			Com_Printf("metrics_start() error creating metrics thread!\n");
+			close(fd);
+			*metrics_unix_path = '\0';
+			return 0;
+		}
+
+		metrics_thread_started = true;
+	}
+
+	__atomic_store_n(&metrics_listener, fd, __ATOMIC_RELEASE);
+
+	Com_Printf("Metrics endpoint listening on %s\n", address);
+
+	return 1;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include "gsc.hpp"
+
+#define METRICS_INTERVAL 1000 // ms between snapshots
+#define METRICS_MAX_RATELIMITS 8
+#define METRICS_BUFFER_SIZE ( 64 * 1024 )
+
+typedef struct
+{
+	int state;
+	int bot;
+	int ping;
+	int rate;
+	char name[32];
+	int downloading;
+	int downloadBytes;
+	int downloadRate; // bytes per second of the current download
+} metricsClient_t;
+
+typedef struct
+{
+	const char *name;
+	unsigned int served;
+	unsigned int droppedAddress;
+	unsigned int droppedSubnet;
+	unsigned int droppedGlobal;
+} metricsRateLimit_t;
+
+// Filled by the game thread, the metrics thread only reads published snapshots
+typedef struct
+{
+	int valid;
+	int maxclients;
+	metricsClient_t clients[MAX_CLIENTS];
+	int bpsTotalBytes;
+	int ubpsTotalBytes;
+	int asyncExec; // queued tasks, -1 when the module is not compiled or busy
+	int asyncMysql;
+	int asyncSqlite;
+	int asyncResolver;
+	int rateLimitCount;
+	metricsRateLimit_t rateLimits[METRICS_MAX_RATELIMITS];
+	unsigned int downloadBytesTotal;
+	int downloadClients;
+	int frameSamples;
+	unsigned int frameAvg; // microseconds between server frames
+	unsigned int frameP50;
+	unsigned int frameP90;
+	unsigned int frameP99;
+	unsigned int frameMax;
+	unsigned int consoleDropped;
+	unsigned int eventsDropped;
+} metricsSnapshot_t;
+
+metricsSnapshot_t *metrics_snapshot_begin();
+void metrics_snapshot_publish();
+int metrics_start(const char *address);
+void metrics_stop();
+int metrics_running();
+
+#endif
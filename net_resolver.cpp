@@ -0,0 +1,402 @@
+#include "net_resolver.hpp"
+
+#if COMPILE_RESOLVER == 1
+
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define MAX_HOSTNAME 256
+
+enum resolver_state
+{
+	RESOLVER_EMPTY,
+	RESOLVER_QUEUED,
+	RESOLVER_BUSY,
+	RESOLVER_DONE
+};
+
+struct resolver_entry
+{
+	char host[MAX_HOSTNAME];
+	resolver_state state;
+	bool valid; // ip holds the last good address, kept while refreshing
+	bool failed; // the last lookup failed
+	bool announce; // result changed, printed by the main thread
+	byte ip[4];
+	int refreshTime;
+	int lastUsed;
+};
+
+struct resolver_request
+{
+	char address[MAX_HOSTNAME + 8];
+	char msg[MAX_STRINGLENGTH]; // out of band message, or empty for a script callback
+	int defaultPort;
+	int callback;
+	unsigned int levelId;
+	stackSavedArgs_t args;
+	resolver_request *next;
+};
+
+static resolver_entry resolver_cache[RESOLVER_CACHE_SIZE];
+static pthread_mutex_t resolver_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolver_cond = PTHREAD_COND_INITIALIZER;
+static bool resolver_started = false;
+
+static resolver_request *first_resolver_request = NULL;
+static int resolver_requests = 0;
+
+static int resolver_milliseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	// wraps, only differences are used
+	return (int)((unsigned int)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void *resolver_thread(void *unused)
+{
+	pthread_mutex_lock(&resolver_mutex);
+
+	while (true)
+	{
+		resolver_entry *entry = NULL;
+
+		for (int i = 0; i < RESOLVER_CACHE_SIZE; i++)
+		{
+			if (resolver_cache[i].state == RESOLVER_QUEUED)
+			{
+				entry = &resolver_cache[i];
+				break;
+			}
+		}
+
+		if (entry == NULL)
+		{
+			pthread_cond_wait(&resolver_cond, &resolver_mutex);
+			continue;
+		}
+
+		char host[MAX_HOSTNAME];
+		strcpy(host, entry->host);
+		entry->state = RESOLVER_BUSY;
+
+		pthread_mutex_unlock(&resolver_mutex);
+
+		struct addrinfo hints, *result = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+
+		int error = getaddrinfo(host, NULL, &hints, &result);
+
+		pthread_mutex_lock(&resolver_mutex);
+
+		// busy entries are never reclaimed, so entry still belongs to host
+		if (error == 0 && result != NULL)
+		{
+			byte *ip = (byte *)&((struct sockaddr_in *)result->ai_addr)->sin_addr;
+
+			if (!entry->valid || entry->failed || memcmp(entry->ip, ip, 4) != 0)
+				entry->announce = true;
+
+			memcpy(entry->ip, ip, 4);
+			entry->valid = true;
+			entry->failed = false;
+		}
+		else
+		{
+			if (!entry->failed)
+				entry->announce = true;
+
+			entry->failed = true;
+		}
+
+		entry->state = RESOLVER_DONE;
+
+		if (result != NULL)
+			freeaddrinfo(result);
+	}
+
+	return NULL;
+}
+
+static int resolver_parse(const char *address, char *host, int *port, int defaultPort)
+{
+	const char *colon = strrchr(address, ':');
+	int length = colon != NULL ? colon - address : strlen(address);
+
+	if (length <= 0 || length >= MAX_HOSTNAME)
+		return 0;
+
+	memcpy(host, address, length);
+	host[length] = '\0';
+
+	*port = colon != NULL ? atoi(colon + 1) : defaultPort;
+
+	return 1;
+}
+
+static void resolver_fill(netadr_t *adr, byte *ip, int port)
+{
+	memset(adr, 0, sizeof(netadr_t));
+	adr->type = NA_IP;
+	memcpy(adr->ip, ip, 4);
+	adr->port = BigShort(port);
+}
+
+// Main thread only. Never blocks, the first lookup of a name returns RESOLVE_PENDING
+// and later calls use the cached address while it is refreshed in the background
+int net_resolve_cached(const char *address, netadr_t *adr, int defaultPort)
+{
+	char host[MAX_HOSTNAME];
+	int port;
+	struct in_addr numeric;
+
+	if (!resolver_parse(address, host, &port, defaultPort))
+		return RESOLVE_FAILED;
+
+	if (inet_pton(AF_INET, host, &numeric) == 1)
+	{
+		resolver_fill(adr, (byte *)&numeric, port);
+		return RESOLVE_OK;
+	}
+
+	pthread_mutex_lock(&resolver_mutex);
+
+	if (!resolver_started)
+	{
+		pthread_t resolver;
+
+		if (pthread_create(&resolver, NULL, resolver_thread, NULL) != 0 || pthread_detach(resolver) != 0)
+		{
+			pthread_mutex_unlock(&resolver_mutex);
+			Com_Printf("net_resolve_cached() error creating resolver thread!\n");
+			return RESOLVE_FAILED;
+		}
+
+		resolver_started = true;
+	}
+
+	int now = resolver_milliseconds();
+	resolver_entry *entry = NULL;
+	resolver_entry *oldest = NULL;
+
+	for (int i = 0; i < RESOLVER_CACHE_SIZE; i++)
+	{
+		resolver_entry *current = &resolver_cache[i];
+
+		if (current->state != RESOLVER_EMPTY && strcmp(current->host, host) == 0)
+		{
+			entry = current;
+			break;
+		}
+
+		// reuse an empty entry, or the least recently used one that is not being looked up
+		if (current->state == RESOLVER_EMPTY)
+		{
+			if (oldest == NULL || oldest->state != RESOLVER_EMPTY)
+				oldest = current;
+		}
+		else if (current->state == RESOLVER_DONE)
+		{
+			if (oldest == NULL || (oldest->state != RESOLVER_EMPTY && current->lastUsed - oldest->lastUsed < 0))
+				oldest = current;
+		}
+	}
+
+	if (entry == NULL)
+	{
+		if (oldest == NULL)
+		{
+			// every entry is being looked up
+			pthread_mutex_unlock(&resolver_mutex);
+			return RESOLVE_PENDING;
+		}
+
+		entry = oldest;
+		memset(entry, 0, sizeof(resolver_entry));
+		strcpy(entry->host, host);
+		entry->state = RESOLVER_DONE;
+		entry->refreshTime = now - RESOLVER_TTL;
+	}
+
+	entry->lastUsed = now;
+
+	if (entry->state == RESOLVER_DONE && now - entry->refreshTime >= (entry->failed ? RESOLVER_NEGATIVE_TTL : RESOLVER_TTL))
+	{
+		entry->state = RESOLVER_QUEUED;
+		entry->refreshTime = now;
+		pthread_cond_signal(&resolver_cond);
+	}
+
+	int result;
+
+	if (entry->valid)
+	{
+		resolver_fill(adr, entry->ip, port);
+		result = RESOLVE_OK;
+	}
+	else if (entry->state != RESOLVER_DONE)
+		result = RESOLVE_PENDING;
+	else
+		result = RESOLVE_FAILED;
+
+	pthread_mutex_unlock(&resolver_mutex);
+
+	return result;
+}
+
+static resolver_request *resolver_add_request(const char *address, int defaultPort)
+{
+	if (resolver_requests >= RESOLVER_MAX_REQUESTS)
+		return NULL;
+
+	resolver_request *request = new resolver_request;
+
+	strncpy(request->address, address, sizeof(request->address) - 1);
+	request->address[sizeof(request->address) - 1] = '\0';
+	request->msg[0] = '\0';
+	request->defaultPort = defaultPort;
+	request->callback = 0;
+	request->levelId = scrVarPub.levelId;
+	request->args.count = 0;
+	request->args.values = NULL;
+
+	request->next = first_resolver_request;
+	first_resolver_request = request;
+	resolver_requests++;
+
+	return request;
+}
+
+// Takes ownership of args, the callback gets the address string or undefined
+int net_resolver_request(const char *address, int callback, stackSavedArgs_t *args)
+{
+	netadr_t adr;
+
+	// starts the lookup, the result is delivered on the next frame at the earliest
+	net_resolve_cached(address, &adr, 0);
+
+	resolver_request *request = resolver_add_request(address, 0);
+
+	if (request == NULL)
+	{
+		stackFreeSavedArgs(args);
+		return 0;
+	}
+
+	request->callback = callback;
+	request->args = *args;
+
+	return 1;
+}
+
+// Sends right away when the address is known, otherwise once it resolves
+int net_resolver_send_oob(const char *address, const char *msg)
+{
+	netadr_t adr;
+	int result = net_resolve_cached(address, &adr, PORT_SERVER);
+
+	if (result == RESOLVE_OK)
+	{
+		NET_OutOfBandPrint(NS_SERVER, adr, msg);
+		return 1;
+	}
+
+	if (result == RESOLVE_FAILED)
+		return 0;
+
+	resolver_request *request = resolver_add_request(address, PORT_SERVER);
+
+	if (request == NULL)
+		return 0;
+
+	strncpy(request->msg, msg, sizeof(request->msg) - 1);
+	request->msg[sizeof(request->msg) - 1] = '\0';
+
+	return 1;
+}
+
+int net_resolver_pending()
+{
+	return resolver_requests;
+}
+
+void net_resolver_deliver()
+{
+	if (!resolver_started)
+		return;
+
+	pthread_mutex_lock(&resolver_mutex);
+
+	for (int i = 0; i < RESOLVER_CACHE_SIZE; i++)
+	{
+		resolver_entry *entry = &resolver_cache[i];
+
+		if (entry->state != RESOLVER_DONE || !entry->announce)
+			continue;
+
+		entry->announce = false;
+
+		if (entry->failed)
+			Com_Printf("Couldn't resolve address: %s\n", entry->host);
+		else
+			Com_Printf("%s resolved to %i.%i.%i.%i\n", entry->host, entry->ip[0], entry->ip[1], entry->ip[2], entry->ip[3]);
+	}
+
+	pthread_mutex_unlock(&resolver_mutex);
+
+	resolver_request **link = &first_resolver_request;
+
+	while (*link != NULL)
+	{
+		resolver_request *request = *link;
+		netadr_t adr;
+		int result = net_resolve_cached(request->address, &adr, request->defaultPort);
+
+		if (result == RESOLVE_PENDING)
+		{
+			link = &request->next;
+			continue;
+		}
+
+		*link = request->next;
+		resolver_requests--;
+
+		if (request->msg[0])
+		{
+			if (result == RESOLVE_OK)
+				NET_OutOfBandPrint(NS_SERVER, adr, request->msg);
+		}
+		else if (request->callback && Scr_IsSystemActive() && scrVarPub.levelId == request->levelId)
+		{
+			stackPushSavedArgs(&request->args);
+
+			if (result == RESOLVE_OK)
+			{
+				char resolved[32];
+
+				if (adr.port)
+					snprintf(resolved, sizeof(resolved), "%i.%i.%i.%i:%i", adr.ip[0], adr.ip[1], adr.ip[2], adr.ip[3], (unsigned short)BigShort(adr.port));
+				else
+					snprintf(resolved, sizeof(resolved), "%i.%i.%i.%i", adr.ip[0], adr.ip[1], adr.ip[2], adr.ip[3]);
+
+				stackPushString(resolved);
+			}
+			else
+				stackPushUndefined();
+
+			short ret = Scr_ExecThread(request->callback, 1 + request->args.count);
+			Scr_FreeThread(ret);
+		}
+
+		stackFreeSavedArgs(&request->args);
+		delete request;
+	}
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef _NET_RESOLVER_HPP_
+#define _NET_RESOLVER_HPP_
+
+#include "gsc.hpp"
+
+#define PORT_SERVER 28960
+
+#define RESOLVER_CACHE_SIZE 64
+#define RESOLVER_MAX_REQUESTS 256
+#define RESOLVER_TTL 300000 // ms before a resolved name is looked up again
+#define RESOLVER_NEGATIVE_TTL 30000 // ms before a failed name is looked up again
+
+#define RESOLVE_FAILED -1
+#define RESOLVE_PENDING 0
+#define RESOLVE_OK 1
+
+int net_resolve_cached(const char *address, netadr_t *adr, int defaultPort);
+int net_resolver_request(const char *address, int callback, stackSavedArgs_t *args);
+int net_resolver_send_oob(const char *address, const char *msg);
+void net_resolver_deliver();
+int net_resolver_pending();
+
+#endif
@@ -0,0 +1,119 @@
+#include "perf_stats.hpp"
+
+#if COMPILE_PERFSTATS == 1
+
+unsigned int perf_accum[PERF_PHASES];
+
+// time spent per phase in each of the last frames
+static unsigned int perf_window[PERF_PHASES][PERF_WINDOW];
+static int perf_next = 0;
+static int perf_frames = 0;
+static unsigned int perf_last_frame = 0;
+
+static const char *perf_names[PERF_PHASES] =
+{
+	"frame",
+	"usercmd",
+	"commands",
+	"script",
+	"async",
+	"pings",
+	"heartbeat"
+};
+
+// Closes the current frame, called once per server frame
+void perf_frame()
+{
+	unsigned int now = perf_begin();
+
+	if (perf_last_frame)
+		perf_accum[PERF_FRAME] = now - perf_last_frame;
+
+	perf_last_frame = now;
+
+	for (int i = 0; i < PERF_PHASES; i++)
+	{
+		perf_window[i][perf_next] = perf_accum[i];
+		perf_accum[i] = 0;
+	}
+
+	perf_next = (perf_next + 1) % PERF_WINDOW;
+
+	if (perf_frames < PERF_WINDOW)
+		perf_frames++;
+}
+
+void perf_reset()
+{
+	memset(perf_accum, 0, sizeof(perf_accum));
+	perf_next = 0;
+	perf_frames = 0;
+	perf_last_frame = 0;
+}
+
+const char *perf_phase_name(int phase)
+{
+	return perf_names[phase];
+}
+
+static int perf_compare(const void *a, const void *b)
+{
+	unsigned int timeA = *(const unsigned int *)a;
+	unsigned int timeB = *(const unsigned int *)b;
+
+	return (timeA > timeB) - (timeA < timeB);
+}
+
+void perf_phase_stats(int phase, perfStats_t *stats)
+{
+	static unsigned int sorted[PERF_WINDOW];
+	unsigned long long total = 0;
+
+	memset(stats, 0, sizeof(perfStats_t));
+
+	// the first frame has no interval
+	int first = phase == PERF_FRAME && perf_frames < PERF_WINDOW ? 1 : 0;
+	int count = perf_frames - first;
+
+	if (count <= 0)
+		return;
+
+	for (int i = 0; i < count; i++)
+	{
+		sorted[i] = perf_window[phase][(perf_next - count + i + PERF_WINDOW) % PERF_WINDOW];
+		total += sorted[i];
+	}
+
+	qsort(sorted, count, sizeof(unsigned int), perf_compare);
+
+	stats->samples = count;
+	stats->avg = total / count;
+	stats->p50 = sorted[count * 50 / 100];
+	stats->p90 = sorted[count * 90 / 100];
+	stats->p99 = sorted[count * 99 / 100];
+	stats->max = sorted[count - 1];
+}
+
+void perf_print()
+{
+	if (Cmd_Argc() > 1 && !strcasecmp(Cmd_Argv(1), "reset"))
+	{
+		perf_reset();
+		Com_Printf("Frame timings reset\n");
+		return;
+	}
+
+	Com_Printf("phase        frames      avg us      p50 us      p90 us      p99 us      max us\n");
+
+	for (int i = 0; i < PERF_PHASES; i++)
+	{
+		perfStats_t stats;
+		perf_phase_stats(i, &stats);
+
+		Com_Printf("%-10s %8i %11u %11u %11u %11u %11u\n", perf_names[i], stats.samples, stats.avg, stats.p50, stats.p90, stats.p99, stats.max);
+	}
+
+	Com_Printf("usercmd and commands include the script callbacks they run, script is their sum\n");
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _PERF_STATS_HPP_
+#define _PERF_STATS_HPP_
+
+#include "gsc.hpp"
+
+#define PERF_WINDOW 1200 // frames kept for the percentiles, a minute at sv_fps 20
+
+// Script callbacks also count towards the usercmd and client command time they happen in
+enum
+{
+	PERF_FRAME, // interval between two server frames
+	PERF_USERCMD,
+	PERF_COMMANDS,
+	PERF_SCRIPT,
+	PERF_ASYNC,
+	PERF_PINGS,
+	PERF_HEARTBEAT,
+	PERF_PHASES
+};
+
+typedef struct
+{
+	int samples;
+	unsigned int avg; // microseconds
+	unsigned int p50;
+	unsigned int p90;
+	unsigned int p99;
+	unsigned int max;
+} perfStats_t;
+
+extern unsigned int perf_accum[PERF_PHASES];
+
+static inline unsigned int perf_begin()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned int)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void perf_end(int phase, unsigned int start)
+{
+	perf_accum[phase] += perf_begin() - start;
+}
+
+void perf_frame();
+void perf_reset();
+const char *perf_phase_name(int phase);
+void perf_phase_stats(int phase, perfStats_t *stats);
+void perf_print();
+
+#endif
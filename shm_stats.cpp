@@ -0,0 +1,98 @@
+#include "shm_stats.hpp"
+
+#if COMPILE_SHMSTATS == 1
+
+#include <errno.h>
+
+static shmStats_t *shm_stats = NULL;
+static char shm_stats_name[MAX_OSPATH];
+
+int shm_stats_running()
+{
+	return shm_stats != NULL;
+}
+
+// The segment is unlinked, readers still mapping it see no more updates
+void shm_stats_stop()
+{
+	if (!shm_stats_running())
+		return;
+
+	munmap(shm_stats, sizeof(shmStats_t));
+	shm_stats = NULL;
+
+	shm_unlink(shm_stats_name);
+	Com_Printf("Server stats no longer shared in %s\n", shm_stats_name);
+}
+
+// name is a POSIX shared memory name like /cod2_28960, readers map it read only. A running segment moves to the new name
+int shm_stats_start(const char *name)
+{
+	shm_stats_stop();
+
+	int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+
+	if (fd < 0)
+	{
+		Com_Printf("shm_stats_start() could not open %s: %s\n", name, strerror(errno));
+		return 0;
+	}
+
+	if (ftruncate(fd, sizeof(shmStats_t)) != 0)
+	{
+		Com_Printf("shm_stats_start() could not size %s: %s\n", name, strerror(errno));
+		close(fd);
+		return 0;
+	}
+
+	void *mapping = mmap(NULL, sizeof(shmStats_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		Com_Printf("shm_stats_start() could not map %s: %s\n", name, strerror(errno));
+		return 0;
+	}
+
+	shm_stats = (shmStats_t *)mapping;
+	snprintf(shm_stats_name, sizeof(shm_stats_name), "%s", name);
+
+	// a segment left by an earlier run keeps counting, readers waiting on the sequence see a change
+	uint32_t sequence = shm_stats->magic == SHM_STATS_MAGIC ? (shm_stats->sequence + 1) & ~1u : 0;
+
+	__atomic_store_n(&shm_stats->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memset((byte *)shm_stats + offsetof(shmStats_t, updateTime), 0, sizeof(shmStats_t) - offsetof(shmStats_t, updateTime));
+	shm_stats->magic = SHM_STATS_MAGIC;
+	shm_stats->version = SHM_STATS_VERSION;
+	shm_stats->size = sizeof(shmStats_t);
+
+	__atomic_store_n(&shm_stats->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+	Com_Printf("Server stats shared in %s\n", name);
+
+	return 1;
+}
+
+// Seqlock write, the body is copied in one go to keep the odd window short
+void shm_stats_publish(const shmStats_t *stats)
+{
+	if (!shm_stats_running())
+		return;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	uint32_t sequence = shm_stats->sequence;
+
+	__atomic_store_n(&shm_stats->sequence, sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy((byte *)shm_stats + offsetof(shmStats_t, updateTime), (const byte *)stats + offsetof(shmStats_t, updateTime), sizeof(shmStats_t) - offsetof(shmStats_t, updateTime));
+	shm_stats->updateTime = (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	__atomic_store_n(&shm_stats->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _SHM_STATS_HPP_
+#define _SHM_STATS_HPP_
+
+#include "gsc.hpp"
+#include "shm_stats_format.hpp"
+
+int shm_stats_start(const char *name);
+void shm_stats_stop();
+int shm_stats_running();
+void shm_stats_publish(const shmStats_t *stats);
+
+#endif
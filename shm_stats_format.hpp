@@ -0,0 +1,55 @@
+#ifndef _SHM_STATS_FORMAT_HPP_
+#define _SHM_STATS_FORMAT_HPP_
+
+/*
+	Layout of the shared memory segment named by sv_shmStats, for external readers.
+	The server rewrites it every frame, a consistent copy is taken like this:
+
+	int fd = shm_open("/cod2_28960", O_RDONLY, 0);
+	const shmStats_t *shared = (const shmStats_t *)mmap(NULL, sizeof(shmStats_t), PROT_READ, MAP_SHARED, fd, 0);
+	shmStats_t copy;
+	uint32_t before, after;
+
+	do
+	{
+		before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+		memcpy(&copy, shared, sizeof(copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+	} while ((before & 1) || before != after);
+*/
+#include <stdint.h>
+
+#define SHM_STATS_MAGIC 0x53444F43 // "CODS"
+#define SHM_STATS_VERSION 1
+#define SHM_STATS_MAX_CLIENTS 64
+
+typedef struct
+{
+	int32_t state; // client_t state, 0 free, 4 active
+	int32_t bot;
+	char name[32];
+	int32_t ping;
+	int32_t team; // 0 none, 1 axis, 2 allies, 3 spectator
+	int32_t sessionState; // 0 playing, 1 dead, 2 spectator, 3 intermission
+	int32_t score;
+	int32_t deaths;
+	float origin[3];
+	int32_t fps;
+} shmStatsClient_t;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // sizeof(shmStats_t) of the writer
+	uint32_t sequence; // odd while the server is writing
+	uint64_t updateTime; // unix time in ms of the last update, readers can tell a stopped server
+	uint32_t frame;
+	int32_t serverTime; // svs.time
+	char mapname[64];
+	int32_t maxclients;
+	shmStatsClient_t clients[SHM_STATS_MAX_CLIENTS];
+} shmStats_t;
+
+#endif
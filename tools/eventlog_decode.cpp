@@ -0,0 +1,239 @@
+/*
+	Converts the binary event log written by logevent() to CSV or JSON lines
+
+	g++ -O2 -o eventlog_decode tools/eventlog_decode.cpp
+	./eventlog_decode [-f csv|jsonl] events_20160101_120000_0.evl ...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "../event_log_format.hpp"
+
+#define MAX_NAMES 1024
+
+static char names[MAX_NAMES][256];
+static bool jsonl = false;
+
+static void print_string(const char *str, int length)
+{
+	putchar('"');
+
+	for (int i = 0; i < length; i++)
+	{
+		unsigned char c = str[i];
+
+		if (jsonl && (c == '"' || c == '\\'))
+			printf("\\%c", c);
+		else if (jsonl && c < 0x20)
+			printf("\\u%04x", c);
+		else if (!jsonl && c == '"')
+			printf("\"\"");
+		else
+			putchar(c);
+	}
+
+	putchar('"');
+}
+
+// Returns 0 when the fields do not fit the record
+static int print_fields(const unsigned char *data, int length, int count)
+{
+	int offset = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (offset >= length)
+			return 0;
+
+		int type = data[offset++];
+
+		printf(jsonl ? (i ? "," : "") : ",");
+
+		switch (type)
+		{
+		case EVENT_FIELD_UNDEFINED:
+			printf(jsonl ? "null" : "");
+			break;
+
+		case EVENT_FIELD_INT:
+		{
+			int32_t value;
+
+			if (offset + 4 > length)
+				return 0;
+
+			memcpy(&value, &data[offset], 4);
+			offset += 4;
+			printf("%" PRId32, value);
+			break;
+		}
+
+		case EVENT_FIELD_FLOAT:
+		{
+			float value;
+
+			if (offset + 4 > length)
+				return 0;
+
+			memcpy(&value, &data[offset], 4);
+			offset += 4;
+			printf("%g", value);
+			break;
+		}
+
+		case EVENT_FIELD_VECTOR:
+		{
+			float value[3];
+
+			if (offset + 12 > length)
+				return 0;
+
+			memcpy(value, &data[offset], 12);
+			offset += 12;
+			printf(jsonl ? "[%g,%g,%g]" : "\"(%g %g %g)\"", value[0], value[1], value[2]);
+			break;
+		}
+
+		case EVENT_FIELD_STRING:
+		{
+			if (offset + 1 > length || offset + 1 + data[offset] > length)
+				return 0;
+
+			int size = data[offset++];
+			print_string((const char *)&data[offset], size);
+			offset += size;
+			break;
+		}
+
+		case EVENT_FIELD_ENTITY:
+		{
+			uint16_t value;
+
+			if (offset + 2 > length)
+				return 0;
+
+			memcpy(&value, &data[offset], 2);
+			offset += 2;
+			printf(jsonl ? "{\"entity\":%u}" : "entity:%u", value);
+			break;
+		}
+
+		default:
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int decode(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "%s: could not open\n", path);
+		return 0;
+	}
+
+	eventLogFileHeader_t header;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) != 0 || header.version != EVENT_LOG_VERSION)
+	{
+		fprintf(stderr, "%s: not an event log\n", path);
+		fclose(file);
+		return 0;
+	}
+
+	uint64_t base = 0;
+	unsigned char data[65536];
+	eventLogRecord_t record;
+
+	// names are defined again at the start of every file
+	memset(names, 0, sizeof(names));
+
+	while (fread(&record, sizeof(record), 1, file) == 1)
+	{
+		int length = record.length - (int)sizeof(record);
+
+		if (length < 0 || (length > 0 && fread(data, length, 1, file) != 1))
+		{
+			fprintf(stderr, "%s: truncated record\n", path);
+			break;
+		}
+
+		if (record.type == EVENT_RECORD_BASE && length == sizeof(uint64_t))
+			memcpy(&base, data, sizeof(uint64_t));
+		else if (record.type == EVENT_RECORD_NAME && record.event < MAX_NAMES && length < 256)
+		{
+			memcpy(names[record.event], data, length);
+			names[record.event][length] = '\0';
+		}
+		else if (record.type == EVENT_RECORD_EVENT)
+		{
+			const char *name = record.event < MAX_NAMES ? names[record.event] : "";
+
+			if (jsonl)
+			{
+				printf("{\"time\":%" PRIu64 ",\"event\":", base + record.time);
+				print_string(name, strlen(name));
+				printf(",\"client\":%i,\"fields\":[", record.client);
+			}
+			else
+			{
+				printf("%" PRIu64 ",", base + record.time);
+				print_string(name, strlen(name));
+				printf(",%i", record.client);
+			}
+
+			if (!print_fields(data, length, record.fields))
+				fprintf(stderr, "%s: malformed fields in a \"%s\" event\n", path, name);
+
+			printf(jsonl ? "]}\n" : "\n");
+		}
+	}
+
+	fclose(file);
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int first = 1;
+
+	if (argc > 2 && strcmp(argv[1], "-f") == 0)
+	{
+		if (strcmp(argv[2], "jsonl") == 0)
+			jsonl = true;
+		else if (strcmp(argv[2], "csv") != 0)
+		{
+			fprintf(stderr, "unknown format %s, use csv or jsonl\n", argv[2]);
+			return 1;
+		}
+
+		first = 3;
+	}
+
+	if (first >= argc)
+	{
+		fprintf(stderr, "usage: %s [-f csv|jsonl] file...\n", argv[0]);
+		return 1;
+	}
+
+	if (!jsonl)
+		printf("time,event,client,fields...\n");
+
+	int result = 0;
+
+	for (int i = first; i < argc; i++)
+	{
+		if (!decode(argv[i]))
+			result = 1;
+	}
+
+	return result;
+}
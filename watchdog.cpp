@@ -0,0 +1,190 @@
+#include "watchdog.hpp"
+
+#if COMPILE_WATCHDOG == 1
+
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+
+#define WATCHDOG_SIGNAL SIGUSR2 // not used by the server
+
+const char * volatile watchdog_current = NULL;
+
+static pthread_t watchdog_main;
+static bool watchdog_started = false;
+static char watchdog_report[MAX_OSPATH];
+
+// written by the main thread every frame
+static int watchdog_beat = 0;
+static int watchdog_beating = 0;
+static int watchdog_threshold = 0;
+static int watchdog_suspended = 0;
+
+// filled by the signal handler on the main thread
+static void *watchdog_frames[WATCHDOG_MAX_FRAMES];
+static int watchdog_frame_count = 0;
+static const char *watchdog_captured = NULL;
+static int watchdog_capture_done = 0;
+
+static int watchdog_milliseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int)((unsigned int)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void watchdog_signal(int sig)
+{
+	int saved = errno;
+
+	watchdog_frame_count = backtrace(watchdog_frames, WATCHDOG_MAX_FRAMES);
+	watchdog_captured = watchdog_current;
+	__atomic_store_n(&watchdog_capture_done, 1, __ATOMIC_RELEASE);
+
+	errno = saved;
+}
+
+static void watchdog_write_report(int stalled, bool captured)
+{
+	const char *where = watchdog_captured ? watchdog_captured : "engine";
+
+	printf("> [LIBCOD] watchdog: no server frame for %i ms, main thread in %s, report written to %s\n", stalled, where, watchdog_report);
+
+	int fd = open(watchdog_report, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+	if (fd < 0)
+		return;
+
+	char date[64];
+	char line[512];
+	time_t now = time(NULL);
+	struct tm local;
+
+	localtime_r(&now, &local);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+
+	int length = snprintf(line, sizeof(line), "==== %s no server frame for %i ms, main thread in %s\n", date, stalled, where);
+
+	if (write(fd, line, length) == length)
+	{
+		if (captured && watchdog_frame_count > 0)
+			backtrace_symbols_fd(watchdog_frames, watchdog_frame_count, fd);
+		else
+		{
+			length = snprintf(line, sizeof(line), "main thread did not answer the backtrace signal\n");
+			write(fd, line, length);
+		}
+	}
+
+	close(fd);
+}
+
+static void *watchdog_thread(void *unused)
+{
+	bool stalled = false;
+	int stalledBeat = 0;
+
+	while (true)
+	{
+		usleep(WATCHDOG_INTERVAL * 1000);
+
+		int beat = __atomic_load_n(&watchdog_beat, __ATOMIC_ACQUIRE);
+
+		if (stalled)
+		{
+			if (beat != stalledBeat)
+			{
+				printf("> [LIBCOD] watchdog: server frames resumed after %i ms\n", beat - stalledBeat);
+				stalled = false;
+			}
+
+			continue;
+		}
+
+		int threshold = __atomic_load_n(&watchdog_threshold, __ATOMIC_RELAXED);
+
+		if (threshold <= 0 || !__atomic_load_n(&watchdog_beating, __ATOMIC_RELAXED) || __atomic_load_n(&watchdog_suspended, __ATOMIC_RELAXED))
+			continue;
+
+		int late = watchdog_milliseconds() - beat;
+
+		if (late <= threshold)
+			continue;
+
+		stalled = true;
+		stalledBeat = beat;
+
+		// the handler runs on the main thread, wherever it is stuck
+		watchdog_frame_count = 0;
+		watchdog_captured = NULL;
+		__atomic_store_n(&watchdog_capture_done, 0, __ATOMIC_RELEASE);
+
+		if (pthread_kill(watchdog_main, WATCHDOG_SIGNAL) == 0)
+		{
+			for (int i = 0; i < WATCHDOG_CAPTURE_TIMEOUT && !__atomic_load_n(&watchdog_capture_done, __ATOMIC_ACQUIRE); i++)
+				usleep(1000);
+		}
+
+		watchdog_write_report(late, __atomic_load_n(&watchdog_capture_done, __ATOMIC_ACQUIRE));
+	}
+
+	return NULL;
+}
+
+// Once per server frame. threshold is the allowed gap between frames in ms, 0 disables the checks
+void watchdog_heartbeat(int threshold)
+{
+	__atomic_store_n(&watchdog_threshold, threshold, __ATOMIC_RELAXED);
+	__atomic_store_n(&watchdog_beat, watchdog_milliseconds(), __ATOMIC_RELEASE);
+	__atomic_store_n(&watchdog_suspended, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&watchdog_beating, 1, __ATOMIC_RELAXED);
+}
+
+// No reports until the next frame, for known long operations like loading a map
+void watchdog_suspend()
+{
+	__atomic_store_n(&watchdog_suspended, 1, __ATOMIC_RELAXED);
+}
+
+int watchdog_running()
+{
+	return watchdog_started;
+}
+
+// Must be called from the main thread
+int watchdog_start(const char *reportPath)
+{
+	if (watchdog_started)
+		return 1;
+
+	strncpy(watchdog_report, reportPath, sizeof(watchdog_report) - 1);
+	watchdog_main = pthread_self();
+
+	// the first backtrace() loads libgcc, that must not happen inside the signal handler
+	void *frame;
+	backtrace(&frame, 1);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = watchdog_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if (sigaction(WATCHDOG_SIGNAL, &action, NULL) != 0)
+		return 0;
+
+	pthread_t watchdog;
+
+	if (pthread_create(&watchdog, NULL, watchdog_thread, NULL) != 0 || pthread_detach(watchdog) != 0)
+	{
+		Com_Printf("watchdog_start() error creating watchdog thread!\n");
+		return 0;
+	}
+
+	watchdog_started = true;
+
+	return 1;
+}
+
+#endif
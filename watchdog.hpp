@@ -0,0 +1,30 @@
+#ifndef _WATCHDOG_HPP_
+#define _WATCHDOG_HPP_
+
+#include "gsc.hpp"
+
+#define WATCHDOG_INTERVAL 50 // ms between checks
+#define WATCHDOG_CAPTURE_TIMEOUT 200 // ms to wait for the main thread to take its backtrace
+#define WATCHDOG_MAX_FRAMES 64
+
+// What the main thread is running, a builtin or hook name or NULL for the engine itself
+extern const char * volatile watchdog_current;
+
+static inline const char *watchdog_enter(const char *name)
+{
+	const char *previous = watchdog_current;
+	watchdog_current = name;
+	return previous;
+}
+
+static inline void watchdog_leave(const char *previous)
+{
+	watchdog_current = previous;
+}
+
+int watchdog_start(const char *reportPath);
+int watchdog_running();
+void watchdog_heartbeat(int threshold);
+void watchdog_suspend();
+
+#endif